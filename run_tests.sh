@@ -10,11 +10,16 @@
 #
 # USAGE:
 #   ./run_tests.sh [options]
+#   ./run_tests.sh --bench [--quick]
 #
 # OPTIONS:
 #   --clean      Clean build directory before compiling
 #   --no-build   Skip build step and run existing test binaries
 #   --verbose    Show detailed compilation output
+#   --bench      Build and run the benchmarks (*_bench.cpp) instead of
+#                the tests, with the plugin's optimization flags. Writes
+#                build/bench/<name>.json
+#   --quick      With --bench, time fewer samples
 #   --help       Display this help message
 #
 # EXIT CODES:
@@ -38,12 +43,14 @@ NC='\033[0m' # No Color
 BUILD_DIR="build"
 TEST_DIR="src/tests"
 TEST_BUILD_DIR="${BUILD_DIR}/tests"
-RACK_SDK="dep/Rack-SDK"
+BENCH_BUILD_DIR="${BUILD_DIR}/bench"
 
 # Parse command line arguments
 CLEAN_BUILD=false
 NO_BUILD=false
 VERBOSE=false
+BENCH=false
+QUICK=false
 
 while [[ $# -gt 0 ]]; do
     case $1 in
@@ -59,6 +66,14 @@ while [[ $# -gt 0 ]]; do
             VERBOSE=true
             shift
             ;;
+        --bench)
+            BENCH=true
+            shift
+            ;;
+        --quick)
+            QUICK=true
+            shift
+            ;;
         --help)
             grep "^#" "$0" | grep -v "#!/bin/bash" | sed 's/^# //' | sed 's/^#//'
             exit 0
@@ -111,11 +126,58 @@ if [ ! -f "plugin.json" ]; then
     exit 2
 fi
 
-# Check if Rack SDK exists
-if [ ! -d "$RACK_SDK" ]; then
-    print_error "Rack SDK not found at $RACK_SDK"
-    print_info "Please ensure the Rack SDK is properly installed in the dep/ directory"
-    exit 2
+################################################################################
+# Benchmarks
+################################################################################
+
+if [ "$BENCH" = true ]; then
+    print_header "Building Benchmarks"
+
+    BENCH_FILES=$(find "$TEST_DIR" -name "*_bench.cpp" 2>/dev/null || true)
+    if [ -z "$BENCH_FILES" ]; then
+        print_error "No benchmark files found in $TEST_DIR"
+        exit 3
+    fi
+
+    mkdir -p "$BENCH_BUILD_DIR"
+
+    # Optimized like the plugin build, against the mock SDK
+    BENCH_FLAGS="-std=c++11 -O3 -funsafe-math-optimizations -I./src -I./${TEST_DIR}/mock"
+    if [ "$(uname -m)" = "x86_64" ]; then
+        BENCH_FLAGS="$BENCH_FLAGS -march=nehalem"
+    fi
+
+    BENCH_ARGS=""
+    if [ "$QUICK" = true ]; then
+        BENCH_ARGS="--quick"
+    fi
+
+    BENCH_FAILED=false
+    for bench_file in $BENCH_FILES; do
+        bench_name=$(basename "$bench_file" .cpp)
+        bench_binary="${BENCH_BUILD_DIR}/${bench_name}"
+
+        print_info "Compiling $bench_name..."
+        if [ "$VERBOSE" = true ]; then
+            echo "g++ $BENCH_FLAGS $bench_file -o $bench_binary -lm"
+        fi
+        if ! g++ $BENCH_FLAGS "$bench_file" -o "$bench_binary" -lm; then
+            print_error "Failed to compile $bench_name"
+            BENCH_FAILED=true
+            continue
+        fi
+
+        print_header "Running $bench_name"
+        if ! "$bench_binary" --json "${BENCH_BUILD_DIR}/${bench_name}.json" $BENCH_ARGS; then
+            print_error "$bench_name failed"
+            BENCH_FAILED=true
+        fi
+    done
+
+    if [ "$BENCH_FAILED" = true ]; then
+        exit 1
+    fi
+    exit 0
 fi
 
 # Clean build directory if requested
@@ -149,9 +211,10 @@ print_info "Found $TEST_COUNT test file(s)"
 if [ "$NO_BUILD" = false ]; then
     print_header "Building Tests"
     
-    # Compilation flags based on Rack SDK
-    CXXFLAGS="-std=c++11 -I./src -I${RACK_SDK}/include -I${RACK_SDK}/dep/include"
-    LDFLAGS="-L${RACK_SDK} -L${RACK_SDK}/dep/lib"
+    # Tests build the real sources against the mock Rack SDK in mock/,
+    # the SDK itself is not needed
+    CXXFLAGS="-std=c++11 -I./src -I./${TEST_DIR}/mock"
+    LDLIBS="-lm"
     
     if [ "$(uname)" = "Darwin" ]; then
         # macOS specific flags
@@ -159,6 +222,8 @@ if [ "$NO_BUILD" = false ]; then
     elif [ "$(uname)" = "Linux" ]; then
         # Linux specific flags
         CXXFLAGS="$CXXFLAGS -DARCH_LIN"
+        # RealtimeSafety_test looks up the pthread calls with dlsym()
+        LDLIBS="$LDLIBS -ldl"
     fi
     
     BUILD_FAILED=false
@@ -169,8 +234,8 @@ if [ "$NO_BUILD" = false ]; then
         
         print_info "Compiling $test_name..."
         
-        # Compile the test (tests are now standalone and don't need wavetable.cpp)
-        compile_cmd="g++ $CXXFLAGS $test_file -o $test_binary -lm"
+        # Compile the test, sources it needs are included into it
+        compile_cmd="g++ $CXXFLAGS $test_file -o $test_binary $LDLIBS"
         
         if [ "$VERBOSE" = true ]; then
             echo "$compile_cmd"
@@ -19,6 +19,43 @@ namespace
   constexpr float MAX_F_CAR = 5000.0f;
   constexpr float MIN_I_MOD = 10.0f;
   constexpr float MAX_I_MOD = 3000.0f;
+
+  // Samples per control update for each context-menu choice
+  constexpr int CONTROL_DIVISIONS[] = {1, 4, 16, 32};
+  constexpr int NUM_CONTROL_RATES = sizeof(CONTROL_DIVISIONS) / sizeof(CONTROL_DIVISIONS[0]);
+
+  // Oversampling factor for each context-menu choice
+  constexpr int OVERSAMPLING_FACTORS[] = {1, 2, 4, 8};
+  constexpr int NUM_OVERSAMPLING = sizeof(OVERSAMPLING_FACTORS) / sizeof(OVERSAMPLING_FACTORS[0]);
+  constexpr int OVERSAMPLING_AUTO = NUM_OVERSAMPLING;
+
+  // Auto oversampling doubles the factor once the breakpoint segment rate
+  // passes AUTO_UP of the oversampled Nyquist frequency, and halves it
+  // only when the halved factor would leave it below AUTO_DOWN
+  constexpr float AUTO_UP = 0.25f;
+  constexpr float AUTO_DOWN = 0.15f;
+
+  // Limiter lookahead in ms for each context-menu choice, 0 is a clipper
+  // without latency
+  constexpr float LOOKAHEAD_TIMES[] = {0.f, 0.5f, 1.f, 2.f, 5.f};
+  constexpr int NUM_LOOKAHEADS = sizeof(LOOKAHEAD_TIMES) / sizeof(LOOKAHEAD_TIMES[0]);
+
+  // Length of the envelope crossfade in seconds
+  constexpr float ENV_FADE_TIME = 0.005f;
+
+  // rescale() applied to each voice lane
+  simd::float_4 rescale4(simd::float_4 x, float xMin, float xMax, float yMin, float yMax)
+  {
+    return yMin + (x - xMin) / (xMax - xMin) * (yMax - yMin);
+  }
+
+  // dsp::quadraticBipolar() applied to each voice lane
+  simd::float_4 quadraticBipolar4(simd::float_4 x)
+  {
+    for (int i = 0; i < 4; i++)
+      x[i] = dsp::quadraticBipolar(x[i]);
+    return x;
+  }
 }
 
 void ReGrandy::updateEnvelopeType(const ProcessArgs &args)
@@ -27,96 +64,297 @@ void ReGrandy::updateEnvelopeType(const ProcessArgs &args)
 
   if (env != static_cast<EnvType>(env_num))
   {
-    DEBUG("Switching to env type: %d", env_num);
     env = static_cast<EnvType>(env_num);
-    go.env.switchEnvType(env);
+    // The oscillators run at the oversampled rate
+    const int fade = envCrossfade ? static_cast<int>(ENV_FADE_TIME * args.sampleRate) : 0;
+    for (int g = 0; g < PORT_MAX_CHANNELS / 4; g++)
+      go[g].setEnvelope(WavetableRegistry::get(env), fade * decimator[g].factor);
   }
 }
 
-void ReGrandy::processModulationInputs()
+void ReGrandy::processModulationInputs(int c)
 {
-  // Process modulation inputs with clear scaling
-  freq_sig = (inputs[FREQ_INPUT].getVoltage() / VOLTAGE_SCALE) * params[FREQCV_PARAM].getValue();
-  bpts_sig = VOLTAGE_SCALE * dsp::quadraticBipolar((inputs[BPTS_INPUT].getVoltage() / VOLTAGE_SCALE) * params[BPTSCV_PARAM].getValue());
-  astp_sig = dsp::quadraticBipolar((inputs[ASTP_INPUT].getVoltage() / VOLTAGE_SCALE) * params[ASTPCV_PARAM].getValue());
-  dstp_sig = dsp::quadraticBipolar((inputs[DSTP_INPUT].getVoltage() / VOLTAGE_SCALE) * params[DSTPCV_PARAM].getValue());
-  grat_sig = (inputs[GRAT_INPUT].getVoltage() / VOLTAGE_SCALE) * params[GRATCV_PARAM].getValue();
-
-  // FM control signals
-  fmod_sig = (inputs[FMOD_INPUT].getVoltage() / VOLTAGE_SCALE) * params[FMODCV_PARAM].getValue();
-  imod_sig = dsp::quadraticBipolar((inputs[IMOD_INPUT].getVoltage() / VOLTAGE_SCALE) * params[IMODCV_PARAM].getValue());
+  // Process modulation inputs with clear scaling, monophonic cables
+  // modulate every voice
+  for (int i = 0; i < NUM_INPUTS; i++)
+    updateInput(i, c);
 }
 
-void ReGrandy::updateGranularParameters()
+void ReGrandy::updateInput(int input, int c)
 {
-  // Update breakpoints if changed
-  int new_nbpts = clamp(static_cast<int>(params[BPTS_PARAM].getValue() + static_cast<int>(bpts_sig)), static_cast<int>(MIN_BPTS), MAX_BPTS);
-  if (new_nbpts != go.num_bpts)
+  GendyOscillator &osc = go[c / 4];
+  const simd::float_4 cv = inputs[input].getPolyVoltageSimd<simd::float_4>(c) / VOLTAGE_SCALE;
+
+  // Each input sets only the oscillator fields that depend on it, so
+  // that audio-rate inputs can be read alone every sample
+  switch (input)
   {
-    go.num_bpts = new_nbpts;
-  }
+    case FREQ_INPUT:
+      freq_sig = cv * params[FREQCV_PARAM].getValue();
+      freq_sig += params[FREQ_PARAM].getValue();
+      osc.freq = simd::clamp(dsp::FREQ_C4 * dsp::exp2_taylor5(freq_sig), MIN_FREQ, MAX_FREQ);
+      break;
+
+    case BPTS_INPUT:
+      bpts_sig = VOLTAGE_SCALE * quadraticBipolar4(cv * params[BPTSCV_PARAM].getValue());
+      for (int i = 0; i < 4; i++)
+        osc.num_bpts[i] = clamp(static_cast<int>(params[BPTS_PARAM].getValue() + static_cast<int>(bpts_sig[i])), static_cast<int>(MIN_BPTS), MAX_BPTS);
+      break;
+
+    case ASTP_INPUT:
+      astp_sig = quadraticBipolar4(cv * params[ASTPCV_PARAM].getValue());
+      osc.max_amp_step = rescale4(params[ASTP_PARAM].getValue() + (astp_sig / BIPOLAR_SCALE), 0.0, 1.0, MIN_AMP_STEP, MAX_AMP_STEP);
+      break;
+
+    case DSTP_INPUT:
+      dstp_sig = quadraticBipolar4(cv * params[DSTPCV_PARAM].getValue());
+      osc.max_dur_step = rescale4(params[DSTP_PARAM].getValue() + (dstp_sig / BIPOLAR_SCALE), 0.0, 1.0, MIN_DUR_STEP, MAX_DUR_STEP);
+      break;
 
-  // Add base parameter values to modulation
-  freq_sig += params[FREQ_PARAM].getValue();
-  grat_sig += params[GRAT_PARAM].getValue();
+    case GRAT_INPUT:
+      grat_sig = cv * params[GRATCV_PARAM].getValue();
+      grat_sig += params[GRAT_PARAM].getValue();
+      osc.g_rate = simd::clamp(dsp::FREQ_C4 * dsp::exp2_taylor5(grat_sig), MIN_G_RATE, MAX_G_RATE);
+      break;
 
-  // Set granular parameters with proper clamping
-  go.freq = clamp(dsp::FREQ_C4 * powf(2.0f, freq_sig), MIN_FREQ, MAX_FREQ);
-  go.max_amp_step = rescale(params[ASTP_PARAM].getValue() + (astp_sig / BIPOLAR_SCALE), 0.0, 1.0, MIN_AMP_STEP, MAX_AMP_STEP);
-  go.max_dur_step = rescale(params[DSTP_PARAM].getValue() + (dstp_sig / BIPOLAR_SCALE), 0.0, 1.0, MIN_DUR_STEP, MAX_DUR_STEP);
-  go.freq_mul = rescale(params[FREQ_PARAM].getValue(), -1.0, 1.0, MIN_FREQ_MUL, MAX_FREQ_MUL);
-  go.g_rate = clamp(dsp::FREQ_C4 * powf(2.0f, grat_sig), MIN_G_RATE, MAX_G_RATE);
+    // FM control signals
+    case FMOD_INPUT:
+      fmod_sig = cv * params[FMODCV_PARAM].getValue();
+      fmod_sig += params[FMOD_PARAM].getValue();
+      osc.f_mod = simd::clamp(dsp::FREQ_C4 * dsp::exp2_taylor5(fmod_sig), MIN_FREQ, MAX_F_CAR);
+      break;
+
+    case IMOD_INPUT:
+      imod_sig = quadraticBipolar4(cv * params[IMODCV_PARAM].getValue());
+      imod_sig += params[IMOD_PARAM].getValue();
+      break;
+
+    default:
+      break;
+  }
 }
 
-void ReGrandy::updateFMParameters()
+void ReGrandy::updateGranularParameters(GendyOscillator &osc)
 {
-  // Set FM state
-  go.is_fm_on = !(params[FMTR_PARAM].getValue() > 0.0f);
+  // The stepped and modulated parameters were set by their inputs
+  osc.freq_mul = rescale(params[FREQ_PARAM].getValue(), -1.0, 1.0, MIN_FREQ_MUL, MAX_FREQ_MUL);
+}
 
-  // Add base parameter values to modulation
-  fmod_sig += params[FMOD_PARAM].getValue();
-  imod_sig += params[IMOD_PARAM].getValue();
+void ReGrandy::updateFMParameters(GendyOscillator &osc)
+{
+  // Set FM state
+  osc.is_fm_on = !(params[FMTR_PARAM].getValue() > 0.0f);
 
   // Set FM parameters with proper clamping
-  go.f_car = clamp(dsp::FREQ_C4 * powf(2.0f, params[FCAR_PARAM].getValue()), MIN_FREQ, MAX_F_CAR);
-  go.f_mod = clamp(dsp::FREQ_C4 * powf(2.0f, fmod_sig), MIN_FREQ, MAX_F_CAR);
-  go.i_mod = rescale(params[IMOD_PARAM].getValue(), 0.f, 1.f, MIN_I_MOD, MAX_I_MOD);
+  osc.f_car = clamp(dsp::FREQ_C4 * powf(2.0f, params[FCAR_PARAM].getValue()), MIN_FREQ, MAX_F_CAR);
+  osc.i_mod = rescale(params[IMOD_PARAM].getValue(), 0.f, 1.f, MIN_I_MOD, MAX_I_MOD);
 }
 
-void ReGrandy::process(const ProcessArgs &args)
+int ReGrandy::getControlDivision()
+{
+  return CONTROL_DIVISIONS[clamp(controlRate, 0, NUM_CONTROL_RATES - 1)];
+}
+
+int ReGrandy::getAudioRateInputs()
+{
+  // Connected inputs that ask for audio-rate CV, one bit per input
+  int mask = 0;
+  for (int i = 0; i < NUM_INPUTS; i++)
+  {
+    if (audioRateCv[i] && inputs[i].isConnected())
+      mask |= 1 << i;
+  }
+  return mask;
+}
+
+int ReGrandy::getOversampling(int group, float sampleRate)
 {
-  float deltaTime = args.sampleTime;
+  if (oversampling < OVERSAMPLING_AUTO)
+    return OVERSAMPLING_FACTORS[clamp(oversampling, 0, NUM_OVERSAMPLING - 1)];
+
+  // Breakpoint segments per second of the fastest voice in the group
+  const GendyOscillator &osc = go[group];
+  float segmentRate = 0.f;
+  for (int i = 0; i < std::min(blockChannels - 4 * group, 4); i++)
+    segmentRate = std::max(segmentRate, osc.freq[i] * osc.num_bpts[i]);
+
+  const float load = segmentRate / (0.5f * sampleRate);
+  int factor = decimator[group].factor;
+
+  while (factor < MAX_OVERSAMPLING && load > AUTO_UP * factor)
+    factor *= 2;
+  while (factor > 1 && load < AUTO_DOWN * (factor / 2))
+    factor /= 2;
+
+  return factor;
+}
+
+void ReGrandy::updateControls(const ProcessArgs &args)
+{
+  // The V/Oct input sets the number of voices, one when unpatched
+  blockChannels = std::max(inputs[FREQ_INPUT].getChannels(), 1);
 
   // Update envelope type if changed
   updateEnvelopeType(args);
 
-  // Handle mirror/fold switch
-  go.is_mirroring = static_cast<int>(params[MIRR_PARAM].getValue());
+  // A new lookahead is crossfaded in by the limiters
+  const float lookaheadMs = LOOKAHEAD_TIMES[clamp(lookahead, 0, NUM_LOOKAHEADS - 1)];
+  for (int c = 0; c < PORT_MAX_CHANNELS; c++)
+    limiter[c].setLookahead(lookaheadMs);
+
+  for (int c = 0; c < blockChannels; c += 4)
+  {
+    GendyOscillator &osc = go[c / 4];
 
-  // Process all modulation inputs
-  processModulationInputs();
+    // Handle mirror/fold switch
+    osc.is_mirroring = static_cast<int>(params[MIRR_PARAM].getValue());
 
-  // Update granular synthesis parameters
-  updateGranularParameters();
+    // Process all modulation inputs
+    processModulationInputs(c);
 
-  // Set distribution type
-  go.dt = static_cast<DistType>(params[PDST_PARAM].getValue());
+    // Update granular synthesis parameters
+    updateGranularParameters(osc);
 
-  // Update FM synthesis parameters
-  updateFMParameters();
+    // Set distribution type
+    osc.dt = static_cast<DistType>(clamp(static_cast<int>(params[PDST_PARAM].getValue()), 0, NUM_DISTS - 1));
 
-  // Process audio
-  go.process(deltaTime);
+    // Update FM synthesis parameters
+    updateFMParameters(osc);
 
-  // Get raw output
-  float rawOutput = go.out();
-  
-  // Process through limiter for anti-clipping and speaker protection
-  float limitedOutput = limiter.process(rawOutput);
+    // Pick the oversampling factor, a change is handed over within the
+    // decimator without a click
+    decimator[c / 4].setFactor(getOversampling(c / 4, args.sampleRate), osc.out());
+
+    // The switches pick a kernel compiled for their positions
+    kernels[c / 4] = &GendyOscillator::getKernel(osc.is_fm_on, osc.is_mirroring, osc.dt);
+  }
+}
+
+void ReGrandy::renderBlock(const ProcessArgs &args, int offset, int length)
+{
+  for (int c = 0; c < blockChannels; c += 4)
+  {
+    GendyOscillator &osc = go[c / 4];
+    SwitchingDecimator &decim = decimator[c / 4];
+    const int factor = decim.factor;
+
+    // Render the raw output of the block at the oversampled rate, ramping
+    // towards the new parameters, then decimate it to the engine rate
+    osc.processBlock(oversampled, length * factor, args.sampleTime / factor, *kernels[c / 4]);
+    decim.process(oversampled, length, handover);
+
+    // Process through limiter for anti-clipping and speaker protection,
+    // each voice is one lane of the float_4 samples
+    for (int i = 0; i < std::min(blockChannels - c, 4); i++)
+      limiter[c + i].process(&oversampled[0][i], &oversampled[0][i], length, 4);
+
+    simd::float_4 *block = buffer[c / 4] + offset;
+    for (int t = 0; t < length; t++)
+      block[t] = VOLTAGE_SCALE * oversampled[t];
+  }
+}
+
+void ReGrandy::process(const ProcessArgs &args)
+{
+  // Read the controls and render the next control period
+  if (controlDivider.getClock() == 0)
+  {
+    controlDivider.setDivision(getControlDivision());
+    updateControls(args);
+
+    audioRateInputs = getAudioRateInputs();
+    if (!audioRateInputs)
+      renderBlock(args, 0, controlDivider.getDivision());
+  }
+
+  int t = controlDivider.getClock();
+
+  // With audio-rate inputs only those are read every sample, and the
+  // voices render one sample at a time to follow them
+  if (audioRateInputs)
+  {
+    for (int c = 0; c < blockChannels; c += 4)
+    {
+      for (int i = 0; i < NUM_INPUTS; i++)
+      {
+        if (audioRateInputs & (1 << i))
+          updateInput(i, c);
+      }
+    }
+    renderBlock(args, t, 1);
+  }
 
   // Output the limited signal
-  outputs[SINE_OUTPUT].setVoltage(VOLTAGE_SCALE * limitedOutput);
-  outputs[INV_OUTPUT].setVoltage(-(VOLTAGE_SCALE * limitedOutput));
+  for (int c = 0; c < blockChannels; c += 4)
+  {
+    simd::float_4 out = buffer[c / 4][t];
+    outputs[SINE_OUTPUT].setVoltageSimd(out, c);
+    outputs[INV_OUTPUT].setVoltageSimd(-out, c);
+  }
+
+  outputs[SINE_OUTPUT].setChannels(blockChannels);
+  outputs[INV_OUTPUT].setChannels(blockChannels);
+
+  controlDivider.process();
+}
+
+int ReGrandy::getLatency()
+{
+  // the decimators of the current oversampling factor, then the limiter
+  float decimation = DecimatorCascade::delay(decimator[0].factor);
+  return static_cast<int>(limiter[0].getLatency()) + static_cast<int>(std::round(decimation));
+}
+
+void ReGrandy::seed(uint64_t s)
+{
+  for (int g = 0; g < PORT_MAX_CHANNELS / 4; g++)
+    go[g].seed(s * (PORT_MAX_CHANNELS / 4) + g);
+}
+
+json_t *ReGrandy::dataToJson()
+{
+  json_t *rootJ = json_object();
+  json_object_set_new(rootJ, "controlRate", json_integer(controlRate));
+  json_object_set_new(rootJ, "oversampling", json_integer(oversampling));
+
+  json_t *audioRateJ = json_array();
+  for (int i = 0; i < NUM_INPUTS; i++)
+    json_array_append_new(audioRateJ, json_boolean(audioRateCv[i]));
+  json_object_set_new(rootJ, "audioRateCv", audioRateJ);
+  json_object_set_new(rootJ, "envCrossfade", json_boolean(envCrossfade));
+  json_object_set_new(rootJ, "lookahead", json_integer(lookahead));
+
+  return rootJ;
+}
+
+void ReGrandy::dataFromJson(json_t *rootJ)
+{
+  json_t *controlRateJ = json_object_get(rootJ, "controlRate");
+  if (controlRateJ)
+    controlRate = clamp(static_cast<int>(json_integer_value(controlRateJ)), 0, NUM_CONTROL_RATES - 1);
+
+  json_t *oversamplingJ = json_object_get(rootJ, "oversampling");
+  if (oversamplingJ)
+    oversampling = clamp(static_cast<int>(json_integer_value(oversamplingJ)), 0, OVERSAMPLING_AUTO);
+
+  json_t *audioRateJ = json_object_get(rootJ, "audioRateCv");
+  if (audioRateJ)
+  {
+    for (int i = 0; i < NUM_INPUTS; i++)
+    {
+      json_t *enabledJ = json_array_get(audioRateJ, i);
+      if (enabledJ)
+        audioRateCv[i] = json_is_true(enabledJ);
+    }
+  }
+
+  json_t *envCrossfadeJ = json_object_get(rootJ, "envCrossfade");
+  if (envCrossfadeJ)
+    envCrossfade = json_is_true(envCrossfadeJ);
+
+  json_t *lookaheadJ = json_object_get(rootJ, "lookahead");
+  if (lookaheadJ)
+    lookahead = clamp(static_cast<int>(json_integer_value(lookaheadJ)), 0, NUM_LOOKAHEADS - 1);
 }
 
 Model *modelReGrandy = createModel<ReGrandy, ReGrandyWidget>("ReGrandy");
@@ -7,8 +7,8 @@
 #pragma once
 
 #include "plugin.hpp"
-#include "dsp/resampler.hpp"
 #include "utils/GrandyOscillator.hpp"
+#include "utils/HalfBand.hpp"
 #include "utils/Limiter.hpp"
 
 struct ReGrandy : Module
@@ -68,20 +68,61 @@ struct ReGrandy : Module
 
   dsp::SchmittTrigger smpTrigger;
 
-  GendyOscillator go;
+  // Each oscillator renders four voices, one per SIMD lane
+  GendyOscillator go[PORT_MAX_CHANNELS / 4];
   
-  AudioLimiter limiter;
+  AudioLimiter limiter[PORT_MAX_CHANNELS];
 
   EnvType env = (EnvType)1;
 
-  float freq_sig = 0.f;
-  float astp_sig = 0.f;
-  float dstp_sig = 0.f;
-  float grat_sig = 0.f;
-  float envs_sig = 0.f;
-  float bpts_sig = 0.f;
-  float fmod_sig = 0.f;
-  float imod_sig = 0.f;
+  // Controls are read once every controlDivider samples. Voices are
+  // rendered one control period at a time into this buffer and played
+  // back one sample per process() call
+  static constexpr int MAX_BLOCK_SIZE = 32;
+  simd::float_4 buffer[PORT_MAX_CHANNELS / 4][MAX_BLOCK_SIZE] = {};
+  dsp::ClockDivider controlDivider;
+  int blockChannels = 1;
+
+  // Voices can run at up to 8x the engine rate, rendered into this
+  // scratch buffer and decimated back per group of four. Each group
+  // keeps its own factor so that auto mode can pick it per group
+  static constexpr int MAX_OVERSAMPLING = 8;
+  simd::float_4 oversampled[MAX_BLOCK_SIZE * MAX_OVERSAMPLING] = {};
+  simd::float_4 handover[MAX_BLOCK_SIZE * MAX_OVERSAMPLING] = {};
+  SwitchingDecimator decimator[PORT_MAX_CHANNELS / 4];
+
+  // Index into the oversampling choices of the context menu, the last
+  // one is auto
+  int oversampling = 0;
+
+  // Index into the control-rate choices of the context menu
+  int controlRate = 2;
+
+  // Inputs whose CV is read every sample while they are connected
+  bool audioRateCv[NUM_INPUTS] = {};
+
+  // Bits of the audio-rate inputs connected in this control period
+  int audioRateInputs = 0;
+
+  // Kernel of each group for its switch positions in this control period
+  const GendyOscillator::Kernel *kernels[PORT_MAX_CHANNELS / 4] = {};
+
+  // Crossfade between envelopes when ENVS_PARAM changes
+  bool envCrossfade = true;
+
+  // Index into the limiter lookahead choices of the context menu, 5 ms
+  // by default
+  int lookahead = 4;
+
+  // Modulation signals for the group of four voices being processed
+  simd::float_4 freq_sig = 0.f;
+  simd::float_4 astp_sig = 0.f;
+  simd::float_4 dstp_sig = 0.f;
+  simd::float_4 grat_sig = 0.f;
+  simd::float_4 envs_sig = 0.f;
+  simd::float_4 bpts_sig = 0.f;
+  simd::float_4 fmod_sig = 0.f;
+  simd::float_4 imod_sig = 0.f;
 
   bool fm_is_on = false;
 
@@ -99,7 +140,10 @@ struct ReGrandy : Module
     configParam(DSTPCV_PARAM, 0.f, 1.f, 0.f, "Duration Step CV Amount");
     configParam(ASTP_PARAM, 0.f, 1.f, 0.f, "Maximum Amplitude Step");
     configParam(ASTPCV_PARAM, 0.f, 1.f, 0.f, "Amplitude Step CV Amount");
-    configParam(PDST_PARAM, 0.f, 2.f, 0.f, "Probability Distribution", "l - LINEAR, c - CAUCHY, a - ARCSIN");
+    std::vector<std::string> distNames;
+    for (int d = 0; d < NUM_DISTS; d++)
+      distNames.push_back(DISTRIBUTIONS[d].name);
+    configSwitch(PDST_PARAM, 0.f, NUM_DISTS - 1, 0.f, "Probability Distribution", distNames);
     configParam(MIRR_PARAM, 0.f, 1.f, 0.f, "Mirror Mode", "Toggle between wrapping and mirroring of breakpoints");
     configParam(GRAT_PARAM, -6.f, 3.f, 0.f, "Granulation Frequency", "Control frequency of the sin wave that is granulated");
     configParam(GRATCV_PARAM, 0.f, 1.f, 0.f, "Granulation Frequency CV Amount");
@@ -111,21 +155,53 @@ struct ReGrandy : Module
     configParam(IMODCV_PARAM, 0.f, 1.f, 0.f, "FM Modulation Index CV Amount");
     configParam(FMTR_PARAM, 0.0f, 1.0f, 0.0f, "FM Mode Toggle");
     
-    // Initialize limiter with default sample rate
-    limiter.init(APP->engine->getSampleRate());
+    // Initialize limiters with default sample rate
+    for (int c = 0; c < PORT_MAX_CHANNELS; c++)
+      limiter[c].init(APP->engine->getSampleRate());
   }
 
   void process(const ProcessArgs &args) override;
+
+  // Restart the random walks of every voice from a seed, so that an
+  // offline render can be repeated exactly
+  void seed(uint64_t s);
+
+  // Delay of the outputs in samples added by the decimators of the first
+  // voices and the limiter lookahead, so that a patch can compensate it
+  int getLatency();
   
-  void onSampleRateChange() override
+  void onSampleRateChange(const SampleRateChangeEvent &e) override
   {
-    limiter.init(APP->engine->getSampleRate());
+    for (int c = 0; c < PORT_MAX_CHANNELS; c++)
+      limiter[c].init(e.sampleRate);
   }
 
+  json_t *dataToJson() override;
+  void dataFromJson(json_t *rootJ) override;
+
+  int getControlDivision();
+  int getAudioRateInputs();
+  int getOversampling(int group, float sampleRate);
+  void updateControls(const ProcessArgs &args);
+  void renderBlock(const ProcessArgs &args, int offset, int length);
   void updateEnvelopeType(const ProcessArgs &args);
-  void processModulationInputs();
-  void updateGranularParameters();
-  void updateFMParameters();
+  void processModulationInputs(int c);
+  void updateInput(int input, int c);
+  void updateGranularParameters(GendyOscillator &osc);
+  void updateFMParameters(GendyOscillator &osc);
+};
+
+// Context menu label of the output latency, which follows the lookahead
+// and oversampling while the menu is open
+struct LatencyLabel : MenuLabel
+{
+  ReGrandy *module;
+
+  void step() override
+  {
+    text = "Output latency: " + std::to_string(module->getLatency()) + " samples";
+    MenuLabel::step();
+  }
 };
 
 struct ReGrandyWidget : ModuleWidget
@@ -179,8 +255,9 @@ struct ReGrandyWidget : ModuleWidget
     // Envs
     addParam(createParam<RoundBlackSnapKnob>(Vec(171, 257), module, ReGrandy::ENVS_PARAM));
 
-    // PDST Mode 
-    addParam(createParam<CKSSThree>(Vec(80.5, 155), module, ReGrandy::PDST_PARAM));
+    // PDST Mode, a snapping trimpot in place of the old three-way switch
+    // so that every distribution can be selected
+    addParam(createParam<Trimpot>(Vec(78.5, 156.5), module, ReGrandy::PDST_PARAM));
 
     // FM Toggle
     addParam(createParam<CKSS>(Vec(105.5, 155), module, ReGrandy::FMTR_PARAM));
@@ -194,4 +271,39 @@ struct ReGrandyWidget : ModuleWidget
     // Inv Output
     addOutput(createOutput<PJ301MPort>(Vec(126, 347), module, ReGrandy::INV_OUTPUT));
   }
+
+  void appendContextMenu(Menu *menu) override
+  {
+    ReGrandy *module = getModule<ReGrandy>();
+
+    menu->addChild(new MenuSeparator);
+
+    menu->addChild(createIndexPtrSubmenuItem("Control rate",
+                                             {"Every sample", "Every 4 samples", "Every 16 samples", "Every 32 samples"},
+                                             &module->controlRate));
+
+    menu->addChild(createIndexPtrSubmenuItem("Oversampling",
+                                             {"1x", "2x", "4x", "8x", "Auto"},
+                                             &module->oversampling));
+
+    menu->addChild(createSubmenuItem("Audio-rate CV", "", [=](Menu *menu)
+    {
+      menu->addChild(createBoolPtrMenuItem("Frequency", "", &module->audioRateCv[ReGrandy::FREQ_INPUT]));
+      menu->addChild(createBoolPtrMenuItem("Breakpoints", "", &module->audioRateCv[ReGrandy::BPTS_INPUT]));
+      menu->addChild(createBoolPtrMenuItem("Duration step", "", &module->audioRateCv[ReGrandy::DSTP_INPUT]));
+      menu->addChild(createBoolPtrMenuItem("Amplitude step", "", &module->audioRateCv[ReGrandy::ASTP_INPUT]));
+      menu->addChild(createBoolPtrMenuItem("Granulation frequency", "", &module->audioRateCv[ReGrandy::GRAT_INPUT]));
+      menu->addChild(createBoolPtrMenuItem("FM modulation frequency", "", &module->audioRateCv[ReGrandy::FMOD_INPUT]));
+      menu->addChild(createBoolPtrMenuItem("FM modulation index", "", &module->audioRateCv[ReGrandy::IMOD_INPUT]));
+    }));
+
+    menu->addChild(createBoolPtrMenuItem("Crossfade envelope changes", "", &module->envCrossfade));
+
+    menu->addChild(createIndexPtrSubmenuItem("Limiter lookahead",
+                                             {"Off (clipper)", "0.5 ms", "1 ms", "2 ms", "5 ms"},
+                                             &module->lookahead));
+    LatencyLabel *latencyLabel = new LatencyLabel;
+    latencyLabel->module = module;
+    menu->addChild(latencyLabel);
+  }
 };
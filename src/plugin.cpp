@@ -1,4 +1,5 @@
 #include "plugin.hpp"
+#include "utils/wavetable.hpp"
 
 
 Plugin *pluginInstance;
@@ -10,6 +11,16 @@ void init(Plugin *p) {
 	// Add modules here
 	p->addModel(modelReGrandy);
 
+	// Build the shared wavetables and distribution tables once and keep
+	// them while the plugin is loaded
+	static WavetableRegistry::Handle wavetables;
+	DistTables::get();
+
+	// Run the oscillator kernels built for the widest instruction set
+	// this CPU has; only the oscillator table is dispatched
+	activeSimdLevel() = detectSimdLevel();
+	INFO("Restock kernels: %s", simdLevelName(activeSimdLevel()));
+
 	// Any other plugin initialization may go here.
 	// As an alternative, consider lazy-loading assets and lookup tables when your module is created to reduce startup times of Rack.
 }
@@ -0,0 +1,461 @@
+/*
+ * Golden_test.cpp
+ * Regression test of the rendered sound against stored references
+ *
+ * Tests cover:
+ * - GendyOscillator wrapped and mirrored, with and without FM
+ * - GendyOscillator with every DistType and every EnvType
+ * - AudioLimiter at 44.1 and 96 kHz
+ * - The whole ReGrandy module at 1x and auto oversampling
+ *
+ * Every case renders from a fixed seed while a fixed script moves its
+ * parameters, and is compared with the reference in golden/<case>.bin:
+ * 16-bit samples scaled to the reference's peak, plus a hash of the
+ * exact float output of the build that wrote it. A case passes when its
+ * SNR against the reference is at least MIN_SNR_DB and the level of
+ * every band within BAND_RANGE_DB of the loudest stays within
+ * BAND_TOLERANCE_DB, so optimizations that only change rounding pass
+ * and changes to the sound do not. Each case runs with the generic
+ * kernels and with the widest level the CPU has.
+ *
+ * Options:
+ *   --exact    also require the generic output to hash the same as the
+ *              reference, for changes that must not move a single bit
+ *              (the build flags must match run_tests.sh)
+ *   --update   rewrite the references from this build, after a change
+ *              to the sound that is meant
+ *
+ * Run from the repository root, like run_tests.sh does.
+ */
+
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <algorithm>
+
+#include "../plugin.cpp"
+#include "../ReGrandy.cpp"
+#include "../utils/wavetable.cpp"
+
+// Test utilities
+namespace TestUtils
+{
+  void assertTrue(bool condition, const std::string& message)
+  {
+    if (!condition)
+    {
+      std::cerr << "FAIL: " << message << std::endl;
+      assert(false);
+    }
+  }
+}
+
+using namespace TestUtils;
+
+const std::string GOLDEN_DIR = "src/tests/golden/";
+const uint64_t SEED = 20190101;
+const float SAMPLE_TIME = 1.f / 44100.f;
+
+const float MIN_SNR_DB = 60.f;
+const float BAND_RANGE_DB = 60.f;
+const float BAND_TOLERANCE_DB = 0.5f;
+const int NUM_BANDS = 16;
+
+const char* DIST_NAMES[NUM_DISTS] = {"linear", "cauchy", "arcsine", "logistic", "hyperbcos", "exponential"};
+const char* ENV_NAMES[NUM_ENVS] = {"sin", "tri", "hann", "welch", "tukey"};
+
+bool exact = false;
+bool update = false;
+
+/*
+ * Interleaved render of a case
+ */
+struct Render
+{
+  int numChannels;
+  std::vector<float> samples;
+
+  int numFrames() const
+  {
+    return samples.size() / numChannels;
+  }
+};
+
+/*
+ * 64-bit FNV-1a of the float bits
+ */
+uint64_t hashSamples(const std::vector<float>& samples)
+{
+  uint64_t h = 14695981039346656037ull;
+  for (float x : samples)
+  {
+    uint32_t bits;
+    std::memcpy(&bits, &x, 4);
+    for (int i = 0; i < 4; i++)
+    {
+      h ^= (bits >> (8 * i)) & 0xff;
+      h *= 1099511628211ull;
+    }
+  }
+  return h;
+}
+
+/*
+ * Reference file: "RSGO", version, frames, channels, scale, hash, then
+ * the samples as int16 of sample / scale, all little endian
+ */
+struct Reference
+{
+  Render render;
+  uint64_t hash;
+};
+
+bool writeReference(const std::string& path, const Render& render)
+{
+  FILE* f = std::fopen(path.c_str(), "wb");
+  if (!f)
+    return false;
+
+  float scale = 1e-9f;
+  for (float x : render.samples)
+    scale = std::max(scale, std::abs(x));
+
+  uint32_t header[4] = {0x4f475352u, 1u, (uint32_t) render.numFrames(), (uint32_t) render.numChannels};
+  uint64_t hash = hashSamples(render.samples);
+  std::fwrite(header, 4, 4, f);
+  std::fwrite(&scale, 4, 1, f);
+  std::fwrite(&hash, 8, 1, f);
+
+  std::vector<int16_t> q(render.samples.size());
+  for (size_t i = 0; i < q.size(); i++)
+    q[i] = (int16_t) std::lrint(render.samples[i] / scale * 32767.f);
+  std::fwrite(q.data(), 2, q.size(), f);
+
+  return std::fclose(f) == 0;
+}
+
+bool readReference(const std::string& path, Reference& ref)
+{
+  FILE* f = std::fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+
+  uint32_t header[4];
+  float scale;
+  bool ok = std::fread(header, 4, 4, f) == 4 && std::fread(&scale, 4, 1, f) == 1
+            && std::fread(&ref.hash, 8, 1, f) == 1 && header[0] == 0x4f475352u && header[1] == 1u;
+
+  if (ok)
+  {
+    std::vector<int16_t> q(header[2] * header[3]);
+    ok = std::fread(q.data(), 2, q.size(), f) == q.size();
+    ref.render.numChannels = header[3];
+    ref.render.samples.resize(q.size());
+    for (size_t i = 0; i < q.size(); i++)
+      ref.render.samples[i] = q[i] * (scale / 32767.f);
+  }
+
+  std::fclose(f);
+  return ok;
+}
+
+/*
+ * Energy of one channel in NUM_BANDS octave-spaced bands, in dB, from
+ * a Hann-windowed DFT of the whole render
+ */
+std::vector<float> bandLevels(const Render& render, int channel)
+{
+  const int n = render.numFrames();
+  std::vector<double> x(n);
+  for (int t = 0; t < n; t++)
+    x[t] = render.samples[t * render.numChannels + channel] * (0.5 - 0.5 * std::cos(2.0 * M_PI * t / n));
+
+  std::vector<double> energy(NUM_BANDS, 1e-30);
+  for (int k = 1; k < n / 2; k++)
+  {
+    double re = 0.0, im = 0.0;
+    for (int t = 0; t < n; t++)
+    {
+      double w = 2.0 * M_PI * k * t / n;
+      re += x[t] * std::cos(w);
+      im -= x[t] * std::sin(w);
+    }
+    // bands split log2(k) evenly up to Nyquist
+    int band = std::min((int) (NUM_BANDS * std::log2((double) k) / std::log2(n / 2.0)), NUM_BANDS - 1);
+    energy[band] += re * re + im * im;
+  }
+
+  std::vector<float> levels(NUM_BANDS);
+  for (int b = 0; b < NUM_BANDS; b++)
+    levels[b] = 10.f * std::log10(energy[b]);
+  return levels;
+}
+
+/*
+ * Compares a render with the reference of the case, or writes the
+ * reference with --update
+ */
+void check(const std::string& name, const Render& render, bool generic)
+{
+  const std::string path = GOLDEN_DIR + name + ".bin";
+
+  if (update)
+  {
+    if (generic)
+    {
+      assertTrue(writeReference(path, render), "Could not write " + path);
+      std::cout << "  " << name << ": reference written" << std::endl;
+    }
+    return;
+  }
+
+  Reference ref;
+  assertTrue(readReference(path, ref), "Missing or damaged reference " + path + ", run with --update");
+  assertTrue(ref.render.numChannels == render.numChannels && ref.render.samples.size() == render.samples.size(),
+             name + " should render as many samples as its reference");
+
+  bool finite = true;
+  double signal = 0.0, noise = 0.0;
+  for (size_t i = 0; i < render.samples.size(); i++)
+  {
+    finite &= std::isfinite(render.samples[i]);
+    double e = render.samples[i] - ref.render.samples[i];
+    signal += (double) ref.render.samples[i] * ref.render.samples[i];
+    noise += e * e;
+  }
+  assertTrue(finite, name + " should render finite samples");
+  const float snr = noise > 0.0 ? 10.f * std::log10(signal / noise) : INFINITY;
+
+  float worstBand = 0.f;
+  for (int c = 0; c < render.numChannels; c++)
+  {
+    std::vector<float> a = bandLevels(ref.render, c);
+    std::vector<float> b = bandLevels(render, c);
+    const float loudest = *std::max_element(a.begin(), a.end());
+    for (int i = 0; i < NUM_BANDS; i++)
+      if (a[i] > loudest - BAND_RANGE_DB)
+        worstBand = std::max(worstBand, std::abs(a[i] - b[i]));
+  }
+
+  const bool same = hashSamples(render.samples) == ref.hash;
+
+  std::cout << std::fixed << std::setprecision(1) << "  " << std::left << std::setw(24) << name << std::right
+            << " SNR " << std::setw(6) << snr << " dB, bands within " << std::setprecision(3) << worstBand << " dB"
+            << (same ? ", bit-exact" : "") << std::endl;
+  std::cout.unsetf(std::ios::fixed);
+
+  assertTrue(snr >= MIN_SNR_DB, name + " drifted from its reference");
+  assertTrue(worstBand <= BAND_TOLERANCE_DB, name + " changed its spectrum");
+  if (exact && generic)
+    assertTrue(same, name + " should match its reference bit for bit");
+}
+
+/*
+ * 1024 samples of four voices from 110 Hz to 4 kHz, with the script
+ * sweeping pitch, step sizes, breakpoints and the FM settings block by
+ * block
+ */
+Render renderOscillator(bool fm, bool mirroring, DistType d, EnvType e)
+{
+  GendyOscillator osc;
+  osc.seed(SEED);
+  osc.is_fm_on = fm;
+  osc.is_mirroring = mirroring;
+  osc.dt = d;
+  osc.setEnvelope(WavetableRegistry::get(e), 0);
+
+  const int blockSize = 16, numBlocks = 64;
+  const GendyOscillator::Kernel& kernel = GendyOscillator::getKernel(fm, mirroring, d);
+
+  Render render;
+  render.numChannels = 4;
+  render.samples.resize(blockSize * numBlocks * 4);
+  simd::float_4* out = reinterpret_cast<simd::float_4*>(render.samples.data());
+
+  for (int b = 0; b < numBlocks; b++)
+  {
+    osc.freq = simd::float_4(110.f, 440.f, 1500.f, 4000.f) * (1.f + 0.25f * std::sin(0.2f * b));
+    osc.max_amp_step = 0.05f + 0.25f * (b % 8) / 8.f;
+    osc.max_dur_step = 0.3f - 0.25f * (b % 5) / 5.f;
+    osc.g_rate = simd::float_4(50.f, 200.f, 800.f, 2000.f) * (1.f + 0.5f * (b % 3));
+    osc.f_mod = 100.f + 20.f * b;
+    osc.f_car = 800.f;
+    osc.i_mod = 50.f + 10.f * b;
+    for (int i = 0; i < 4; i++)
+      osc.num_bpts[i] = b < numBlocks / 2 ? 6 + 4 * i : 24 - 4 * i;
+
+    osc.processBlock(out + b * blockSize, blockSize, SAMPLE_TIME, kernel);
+  }
+  return render;
+}
+
+/*
+ * 4096 samples of a 440 Hz tone swelling from 0 to 7 V and back
+ */
+Render renderLimiter(float sampleRate)
+{
+  AudioLimiter limiter;
+  limiter.init(sampleRate);
+
+  Render render;
+  render.numChannels = 1;
+  render.samples.resize(4096);
+  for (int t = 0; t < 4096; t++)
+    render.samples[t] = 7.f * std::sin(2.f * M_PI * 440.f * t / sampleRate) * std::sin(M_PI * t / 4096.f);
+
+  limiter.process(render.samples.data(), render.samples.data(), 4096, 1);
+  return render;
+}
+
+/*
+ * 2048 samples of four voices of the module, with the script turning
+ * the pitch, breakpoint and envelope knobs and flipping FM halfway
+ */
+Render renderModule(int oversampling)
+{
+  ReGrandy module;
+  Module::SampleRateChangeEvent e = {44100.f, SAMPLE_TIME};
+  module.onSampleRateChange(e);
+  module.oversampling = oversampling;
+  module.outputs[ReGrandy::SINE_OUTPUT].channels = 1;
+  module.outputs[ReGrandy::INV_OUTPUT].channels = 1;
+
+  Input& freq = module.inputs[ReGrandy::FREQ_INPUT];
+  freq.channels = 4;
+  for (int c = 0; c < 4; c++)
+    freq.voltages[c] = c - 1.f;
+  module.params[ReGrandy::FREQCV_PARAM].setValue(1.f);
+  module.params[ReGrandy::ASTP_PARAM].setValue(0.6f);
+  module.params[ReGrandy::DSTP_PARAM].setValue(0.4f);
+  module.seed(SEED);
+
+  Render render;
+  render.numChannels = 4;
+  render.samples.resize(2048 * 4);
+
+  Module::ProcessArgs args = {44100.f, SAMPLE_TIME, 0};
+  for (int t = 0; t < 2048; t++)
+  {
+    module.params[ReGrandy::FREQ_PARAM].setValue(std::sin(t / 300.f));
+    module.params[ReGrandy::BPTS_PARAM].setValue(6 + (t / 256) * 4);
+    module.params[ReGrandy::ENVS_PARAM].setValue(1 + (t / 512));
+    module.params[ReGrandy::FMTR_PARAM].setValue(t < 1024);
+
+    args.frame = t;
+    module.process(args);
+    std::memcpy(&render.samples[t * 4], module.outputs[ReGrandy::SINE_OUTPUT].voltages, 4 * sizeof(float));
+  }
+  return render;
+}
+
+void testOscillatorModes(bool generic)
+{
+  std::cout << "Testing oscillator modes..." << std::endl;
+
+  check("osc_wrap", renderOscillator(false, false, LINEAR, TRI), generic);
+  check("osc_mirror", renderOscillator(false, true, LINEAR, TRI), generic);
+  check("osc_fm", renderOscillator(true, false, LINEAR, TRI), generic);
+  check("osc_fm_mirror", renderOscillator(true, true, LINEAR, TRI), generic);
+
+  std::cout << "  ✓ Oscillator mode test passed" << std::endl;
+}
+
+void testDistributions(bool generic)
+{
+  std::cout << "Testing distributions..." << std::endl;
+
+  // LINEAR is osc_wrap
+  for (int d = 1; d < NUM_DISTS; d++)
+    check(std::string("osc_dist_") + DIST_NAMES[d], renderOscillator(false, false, (DistType) d, TRI), generic);
+
+  std::cout << "  ✓ Distribution test passed" << std::endl;
+}
+
+void testEnvelopes(bool generic)
+{
+  std::cout << "Testing envelopes..." << std::endl;
+
+  // TRI is osc_wrap
+  for (int e = 0; e < NUM_ENVS; e++)
+    if (e != TRI)
+      check(std::string("osc_env_") + ENV_NAMES[e], renderOscillator(false, false, LINEAR, (EnvType) e), generic);
+
+  std::cout << "  ✓ Envelope test passed" << std::endl;
+}
+
+void testLimiter(bool generic)
+{
+  std::cout << "Testing limiter..." << std::endl;
+
+  check("limiter_44100", renderLimiter(44100.f), generic);
+  check("limiter_96000", renderLimiter(96000.f), generic);
+
+  std::cout << "  ✓ Limiter test passed" << std::endl;
+}
+
+void testModule(bool generic)
+{
+  std::cout << "Testing module..." << std::endl;
+
+  check("module_1x", renderModule(0), generic);
+  check("module_auto", renderModule(4), generic);
+
+  std::cout << "  ✓ Module test passed" << std::endl;
+}
+
+// Main test runner
+int main(int argc, char** argv)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    if (!std::strcmp(argv[i], "--exact"))
+      exact = true;
+    else if (!std::strcmp(argv[i], "--update"))
+      update = true;
+    else
+    {
+      std::cerr << "usage: " << argv[0] << " [--exact] [--update]" << std::endl;
+      return 1;
+    }
+  }
+
+  std::cout << "========================================" << std::endl;
+  std::cout << "Running Golden Output Tests" << std::endl;
+  std::cout << "========================================" << std::endl << std::endl;
+
+  try
+  {
+    // references are written from the generic kernels
+    SimdLevel levels[2] = {SIMD_GENERIC, detectSimdLevel()};
+    for (int l = 0; l < (levels[1] != SIMD_GENERIC && !update ? 2 : 1); l++)
+    {
+      activeSimdLevel() = levels[l];
+      std::cout << "Kernels: " << simdLevelName(levels[l]) << std::endl;
+
+      testOscillatorModes(l == 0);
+      testDistributions(l == 0);
+      testEnvelopes(l == 0);
+      testLimiter(l == 0);
+      testModule(l == 0);
+      std::cout << std::endl;
+    }
+    activeSimdLevel() = SIMD_GENERIC;
+
+    std::cout << "========================================" << std::endl;
+    std::cout << "All tests passed! ✓" << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    return 0;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << std::endl << "Test failed with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
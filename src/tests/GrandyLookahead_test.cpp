@@ -0,0 +1,322 @@
+/*
+ * GrandyLookahead_test.cpp
+ * Tests for the breakpoint lookahead of GendyOscillator
+ *
+ * Tests cover:
+ * - Lookahead leaves the output unchanged for a fixed seed
+ * - Dense segments with lookahead
+ * - Walk steps per sample with aligned breakpoints
+ * - Walk steps per sample with dense segments in some lanes
+ * - Worst-case time per sample with and without lookahead
+ *
+ * Compiles the real header against the mock Rack SDK in mock/.
+ */
+
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+
+#include "../utils/GrandyOscillator.hpp"
+#include "../utils/wavetable.cpp"
+
+using namespace rack;
+
+// Test utilities
+namespace TestUtils
+{
+  void assertTrue(bool condition, const std::string& message)
+  {
+    if (!condition)
+    {
+      std::cerr << "FAIL: " << message << std::endl;
+      assert(false);
+    }
+  }
+
+  void assertEquals(int expected, int actual, const std::string& message)
+  {
+    if (expected != actual)
+    {
+      std::cerr << "FAIL: " << message << std::endl;
+      std::cerr << "  Expected: " << expected << ", Got: " << actual << std::endl;
+      assert(false);
+    }
+  }
+}
+
+using namespace TestUtils;
+
+const float SAMPLE_TIME = 1.f / 44100.f;
+
+/*
+ * Number of lanes of osc whose generator advanced since state was taken,
+ * which is the number of random walk steps taken in between
+ */
+int walksSince(const GendyOscillator& osc, const uint32_t (&state)[4])
+{
+  int n = 0;
+  for (int i = 0; i < 4; i++)
+    n += osc.rng[i].s0[0] != state[i];
+  return n;
+}
+
+void takeState(const GendyOscillator& osc, uint32_t (&state)[4])
+{
+  for (int i = 0; i < 4; i++)
+    state[i] = osc.rng[i].s0[0];
+}
+
+/*
+ * Runs a pair of oscillators with the same seed, one of them walking
+ * ahead, and returns the largest output difference
+ */
+float compareLookahead(float freq, bool fm, bool mirroring, int numSamples)
+{
+  GendyOscillator a, b;
+  a.seed(1234);
+  b.seed(1234);
+  a.lookahead = false;
+  b.lookahead = true;
+
+  GendyOscillator* both[2] = {&a, &b};
+  for (GendyOscillator* osc : both)
+  {
+    osc->freq = simd::float_4(freq, freq * 1.3f, freq * 0.7f, freq * 2.1f);
+    osc->is_fm_on = fm;
+    osc->is_mirroring = mirroring;
+    osc->max_amp_step = 0.3f;
+    osc->max_dur_step = 0.3f;
+    osc->dt = CAUCHY;
+  }
+
+  float maxDiff = 0.f;
+  for (int t = 0; t < numSamples; t++)
+  {
+    a.process(SAMPLE_TIME);
+    b.process(SAMPLE_TIME);
+    for (int i = 0; i < 4; i++)
+      maxDiff = std::max(maxDiff, std::abs(a.out()[i] - b.out()[i]));
+  }
+  return maxDiff;
+}
+
+void testLookaheadMatchesDirectWalk()
+{
+  std::cout << "Testing lookahead keeps the output of a seed..." << std::endl;
+
+  assertTrue(compareLookahead(261.626f, false, false, 20000) == 0.f, "Lookahead should not change the wrapped walk");
+  assertTrue(compareLookahead(261.626f, false, true, 20000) == 0.f, "Lookahead should not change the mirrored walk");
+  assertTrue(compareLookahead(110.f, true, false, 20000) == 0.f, "Lookahead should not change the FM output");
+
+  std::cout << "  ✓ Lookahead output test passed" << std::endl;
+}
+
+void testLookaheadDenseSegments()
+{
+  std::cout << "Testing lookahead with segments shorter than a sample..." << std::endl;
+
+  // 12 breakpoints at 6 kHz and above put several in every sample
+  assertTrue(compareLookahead(6000.f, false, false, 5000) == 0.f, "Lookahead should not change dense segments");
+
+  std::cout << "  ✓ Dense segment test passed" << std::endl;
+}
+
+/*
+ * Largest number of walk steps one oscillator takes in a sample when
+ * all four lanes reach their breakpoints together
+ */
+int maxWalksPerSample(bool lookahead)
+{
+  GendyOscillator osc;
+  osc.seed(99);
+  osc.lookahead = lookahead;
+
+  int worst = 0;
+  uint32_t state[4];
+  for (int t = 0; t < 20000; t++)
+  {
+    takeState(osc, state);
+    osc.process(SAMPLE_TIME);
+    // the first sample walks every lane from the initial state
+    if (t > 0)
+      worst = std::max(worst, walksSince(osc, state));
+  }
+  return worst;
+}
+
+void testWalksPerSample()
+{
+  std::cout << "Testing walk steps per sample with aligned breakpoints..." << std::endl;
+
+  assertEquals(4, maxWalksPerSample(false), "Without lookahead all four lanes walk in the same sample");
+  assertEquals(1, maxWalksPerSample(true), "With lookahead at most one lane should walk per sample");
+
+  std::cout << "  ✓ Walks per sample test passed" << std::endl;
+}
+
+/*
+ * Number of random walk steps lane i of osc took since its generator
+ * was copied into before, each walk draws one uniform4()
+ */
+int stepsSince(Xoshiro128x4 before, const GendyOscillator& osc, int i)
+{
+  for (int n = 0; n <= 2 * MAX_SEGMENTS_PER_SAMPLE; n++)
+  {
+    if (std::equal(before.s0, before.s0 + 4, osc.rng[i].s0))
+      return n;
+    before.uniform4();
+  }
+  return -1;
+}
+
+void testDenseWalksPerSample()
+{
+  std::cout << "Testing walk steps per sample with dense segments..." << std::endl;
+
+  // lanes 0 and 2 pass 3.3 and 1.6 breakpoints per sample, lanes 1
+  // and 3 have segments of many samples
+  GendyOscillator osc;
+  osc.seed(7);
+  osc.freq = simd::float_4(12000.f, 300.f, 6000.f, 450.f);
+
+  int densePassed = 0;
+  for (int t = 0; t < 20000; t++)
+  {
+    Xoshiro128x4 before[4];
+    int index[4];
+    bool dense[4];
+    for (int i = 0; i < 4; i++)
+    {
+      before[i] = osc.rng[i];
+      index[i] = osc.index[i];
+      dense[i] = osc.speed[i] > 1.f;
+    }
+
+    osc.process(SAMPLE_TIME);
+    if (t == 0)
+      continue;
+
+    int sparseWalks = 0;
+    for (int i = 0; i < 4; i++)
+    {
+      int n = stepsSince(before[i], osc, i);
+      assertTrue(n >= 0, "Walk steps should be countable");
+      if (dense[i])
+      {
+        int passed = (osc.index[i] - index[i] + osc.num_bpts[i]) % osc.num_bpts[i];
+        assertEquals(passed, n, "A dense lane should walk each breakpoint it passes and none ahead");
+        densePassed += passed;
+      }
+      else
+      {
+        sparseWalks += n;
+      }
+    }
+    assertTrue(sparseWalks <= 1, "The other lanes should still share one walk per sample");
+  }
+
+  // dense lanes walk every breakpoint they pass within the sample, one
+  // walk ahead per sample could not keep up with them
+  assertTrue(densePassed > 20000, "The dense lanes should pass several breakpoints per sample");
+
+  std::cout << "  ✓ Dense walks per sample test passed" << std::endl;
+}
+
+struct Timing
+{
+  double mean, p99, max;
+};
+
+/*
+ * Times every sample of a bank of oscillators whose breakpoints all
+ * line up, as with several identical voices in a patch
+ */
+Timing timeBank(bool lookahead, int numOscillators, int numSamples)
+{
+  typedef std::chrono::steady_clock Clock;
+
+  std::vector<GendyOscillator> bank(numOscillators);
+  for (int o = 0; o < numOscillators; o++)
+  {
+    bank[o].seed(o);
+    bank[o].lookahead = lookahead;
+    bank[o].is_fm_on = false;
+  }
+
+  // settle the walks before timing
+  for (int t = 0; t < 1000; t++)
+    for (GendyOscillator& osc : bank)
+      osc.process(SAMPLE_TIME);
+
+  std::vector<double> ns(numSamples);
+  for (int t = 0; t < numSamples; t++)
+  {
+    Clock::time_point start = Clock::now();
+    for (GendyOscillator& osc : bank)
+      osc.process(SAMPLE_TIME);
+    ns[t] = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+  }
+
+  Timing r;
+  r.mean = 0.0;
+  for (double x : ns)
+    r.mean += x;
+  r.mean /= numSamples;
+
+  std::sort(ns.begin(), ns.end());
+  r.p99 = ns[(size_t) (0.99 * (numSamples - 1))];
+  r.max = ns.back();
+  return r;
+}
+
+void benchmarkWorstCase()
+{
+  std::cout << "Benchmarking time per sample, 8 oscillators with aligned breakpoints..." << std::endl;
+
+  const int numOscillators = 8;
+  const int numSamples = 50000;
+
+  Timing before = timeBank(false, numOscillators, numSamples);
+  Timing after = timeBank(true, numOscillators, numSamples);
+
+  // the maximum includes scheduler noise, p99 is the steadier figure
+  std::cout << std::fixed << std::setprecision(1)
+            << "  walk at breakpoint:  mean " << before.mean << " ns, p99 " << before.p99 << " ns, max " << before.max << " ns" << std::endl
+            << "  walk one step ahead: mean " << after.mean << " ns, p99 " << after.p99 << " ns, max " << after.max << " ns" << std::endl;
+
+  std::cout << "  ✓ Worst-case benchmark done" << std::endl;
+}
+
+// Main test runner
+int main()
+{
+  std::cout << "========================================" << std::endl;
+  std::cout << "Running GendyOscillator Lookahead Tests" << std::endl;
+  std::cout << "========================================" << std::endl << std::endl;
+
+  try
+  {
+    testLookaheadMatchesDirectWalk();
+    testLookaheadDenseSegments();
+    testWalksPerSample();
+    testDenseWalksPerSample();
+    benchmarkWorstCase();
+
+    std::cout << std::endl << "========================================" << std::endl;
+    std::cout << "All tests passed! ✓" << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    return 0;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << std::endl << "Test failed with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -1,7 +1,7 @@
 /*
  * GrandyOscillator_test.cpp
  * Unit tests for GendyOscillator (granular stochastic dynamic synthesis)
- * 
+ *
  * Tests cover:
  * - Oscillator initialization and state
  * - process() method with various delta times
@@ -10,14 +10,13 @@
  * - Phase progression and wraparound
  * - Boundary conditions and edge cases
  * - Configuration options (FM, mirroring, granulation)
+ * - Seeded random walks and the Xoshiro128x4 streams
+ *
+ * The oscillator is the real one from src/utils, compiled against the
+ * mock SDK in mock/. It runs four voices at once, one per lane of the
+ * float_4 fields, so the checks below look at every lane.
  */
 
-// Define test environment before including headers
-#define RACK_HPP_INCLUDED
-#define TABLE_SIZE 2048
-#define M_PI 3.14159265358979323846
-#define MAX_BPTS 50
-
 #include <iostream>
 #include <cmath>
 #include <cassert>
@@ -25,357 +24,8 @@
 #include <string>
 #include <cstdlib>
 
-// Minimal Rack SDK mock for testing
-namespace rack {
-    namespace random {
-        static inline float uniform() { return (float)rand() / RAND_MAX; }
-        static inline float normal() { return uniform() * 2.0f - 1.0f; }
-    }
-    namespace logger {
-        enum Level { DEBUG_LEVEL, INFO_LEVEL, WARN_LEVEL, FATAL_LEVEL };
-        static inline void log(Level level, const char* filename, int line, const char* func, const char* format, ...) {}
-    }
-    namespace dsp {
-        // Empty for now
-    }
-}
-
-#define DEBUG(format, ...) do {} while(0)
-
-// Include wavetable definitions inline
-namespace rack {
-  float wrap(float in, float lb, float ub) {
-    float out = in;
-    if (in > ub) out = lb;
-    else if (in < lb) out = ub;
-    return out;
-  }
-
-  float mirror(float in, float lb, float ub) {
-    float out = in;
-    if (in > ub) {
-      out = ub - (in - ub);
-    }
-    else if (in < lb) {
-      out = lb + (lb - in);
-    }
-    return out;
-  }
-
-  enum DistType {
-    LINEAR,
-    CAUCHY,
-    ARCSINE
-  };
-
-  struct gRandGen {
-    float my_rand(DistType t, float rand) {
-      float c, temp, out;
-      float a = 0.5f;
-      
-      switch (t) {
-        case LINEAR:
-          return rand; 
-        case CAUCHY:
-          c = atan(10 * a);
-          temp = (1.f/a) * tan(c * (2.f * rand - 1.f));
-          out = temp*0.1f;
-          return out;
-        case ARCSINE:
-          c = sinf(1.5707963f * a); 
-		      out = sinf(M_PI * (rand - 0.5f) * a) / c;
-          return out;
-        default:
-          break;
-      }
-      return rand;
-    }
-  };
-   
-  enum EnvType {
-    SIN,
-    TRI,
-    HANN,
-    WELCH,
-    TUKEY,
-    NUM_ENVS
-  };
-
-  struct Wavetable {
-    float table[TABLE_SIZE];
-    EnvType et;
-
-    Wavetable() {
-      et = SIN;
-      initSinWav(); 
-    }
-
-    Wavetable(EnvType e) {
-      et = e;
-      init(e);
-    }
-
-    void init(EnvType e) {
-      switch (e) {
-        case SIN: initSinWav(); break;
-        case TRI: initTriEnv(); break;
-        case HANN: initHannEnv(); break;
-        case WELCH: initWelchEnv(); break;
-        case TUKEY: initTukeyEnv(); break;
-        default: initSinWav();
-      }
-    }
-
-    void switchEnvType(EnvType e) {
-      if (et != e) {
-        et = e;
-        init(e); 
-      }
-    }
-
-    void initSinWav() {
-      float phase = 0.f;
-      for (int i=0; i<TABLE_SIZE; i++) {
-        table[i] = sinf(2.f*M_PI * phase); 
-        phase += (float) i  / (2.f*M_PI);
-      }
-    }
-
-    void initTriEnv() {
-      float phase = 0.f;
-      for (int i=0; i<TABLE_SIZE; i++) {
-        if (phase < 0.5f) {
-          table[i] = ((2.f * i) / TABLE_SIZE);
-        }
-        else  {
-          table[i] = ((-2.f * i) / TABLE_SIZE) + 2.f;
-        }
-        phase += 1.f / TABLE_SIZE;
-      }
-    }
-
-    void initHannEnv() {
-      float a_0 = 0.5f;
-      for (int i=0; i<TABLE_SIZE; i++) {
-        table[i] = a_0 * (1 - cosf((2.f * M_PI * ((float) i / TABLE_SIZE)) / 1.f));
-      }
-    }
-
-    void initWelchEnv() {
-      float ts = (float) TABLE_SIZE;
-      for (int i=0; i<TABLE_SIZE; i++) {
-        table[i] = 1.f - pow(((float) i - (ts / 2.f)) / (ts / 2.f), 2); 
-      }
-    }
-
-    void initTukeyEnv() {
-      float p1,p2,N,alpha;
-      alpha = 0.5f;
-      N = (float) TABLE_SIZE;
-      p1 = alpha * N / 2;
-      p2 = N * (1 - (alpha / 2));
-
-      for (int i=0; i<TABLE_SIZE; i++) {
-        if (i < p1) {
-          table[i] = 0.5f * (1 + cosf(M_PI * (((2 * i) / (alpha * N)) - 1)));
-        }
-        else if (i <= p2) { 
-          table[i] = 1.f; 
-        } 
-        else {
-          table[i] = 0.5f * (1 + cosf(M_PI * (((2 * i) / (alpha * N)) - (2 / alpha) + 1)));
-        }
-      }
-    }
-
-    float operator[](int x) {
-      return table[x];
-    }
-
-    float operator[](float x) {
-      return index(x); 
-    }
-
-    float index(float x) {
-      float fl = floorf(x);
-      float ph = x - fl;
-      float lb = table[(int) fl];
-      float ub = table[(int) ceilf(x)];
-      return ((1.0 - ph) * lb) + (ph * ub);
-    }
-
-    float get(float x) {
-      if (x > 1.000000) DEBUG("BAD!\n");
-      return index(x * (float) TABLE_SIZE); 
-    }
-  };
-
-  // GendyOscillator definition
-  struct GendyOscillator {
-    float phase = 1.f;
-    
-    bool GRAN_ON = true;
-    bool is_fm_on = true; 
-    bool is_mirroring = false;
-
-    int num_bpts = 12;
-    int min_freq = 30; 
-    int max_freq = 1000;
-
-    float amps[MAX_BPTS] = {0.f};
-    float durs[MAX_BPTS] = {1.f};
-    float offs[MAX_BPTS] = {0.f};
-    float rats[MAX_BPTS] = {1.f};
-
-    int index = 0;
-    float amp = 0.0; 
-    float amp_next = amps[0];
-    
-    float max_amp_step = 0.05f;
-    float max_dur_step = 0.05f;
-    float max_off_step = 0.005f;
-    float max_rat_step = 0.01f;
-
-    float speed = 0.0;
-    float rate = 0.0;
-
-    float freq_mul = 1.0;
-
-    float off = 0.0;
-    float off_next = 0.0;
-
-    float g_idx = 0.f;
-    float g_idx_next = 0.5f;
-
-    float g_amp = 0.f;
-    float g_amp_next = 0.f;
-    float g_rate = 1.f;
-
-    float rat = 1.f;
-    float rat_next = 1.f;
-
-    Wavetable sample = Wavetable(SIN);
-    Wavetable env = Wavetable(TRI); 
-
-    DistType dt = LINEAR;
-    gRandGen rg;
-    
-    float amp_out = 0.f;
-
-    float f_mod = 400.f;
-    float f_car = 800.f;
-    
-    float f_car1 = f_car;
-    float f_car2 = f_car;
-
-    float i_mod = 100.f;
-
-    float phase_mod1 = 0.f;
-    float phase_mod2 = 0.f;
-    
-    float phase_car1 = 0.f;
-    float phase_car2 = 0.f;
-
-    bool last_flag = false;
-
-    int count = 0;
-
-    float freq = 261.626f;
-
-    void process(float deltaTime) {
-      last_flag = false;
-      if (phase >= 1.0) {
-        phase -= 1.0;
-        amp = amp_next;
-        rat = rat_next;
-        index = (index + 1) % num_bpts;
-        last_flag = index == num_bpts - 1;
-
-        if (is_mirroring) {
-          amps[index] = mirror(amps[index] + (max_amp_step * rg.my_rand(dt, random::normal())), -1.0f, 1.0f); 
-          durs[index] = mirror(durs[index] + (max_dur_step * rg.my_rand(dt, random::normal())), 0.5f, 1.5f);
-          offs[index] = mirror(offs[index] + (max_off_step * rg.my_rand(dt, random::normal())), 0.f, 1.0f);
-          rats[index] = mirror(rats[index] + (max_off_step * rg.my_rand(dt, random::normal())), 0.7f, 1.3f);
-        }
-        else {
-          amps[index] = wrap(amps[index] + (max_amp_step * rg.my_rand(dt, random::normal())), -1.0f, 1.0f); 
-          durs[index] = wrap(durs[index] + (max_dur_step * rg.my_rand(dt, random::normal())), 0.5f, 1.5f);
-          offs[index] = wrap(offs[index] + (max_off_step * rg.my_rand(dt, random::normal())), 0.f, 1.0f);
-          rats[index] = wrap(rats[index] + (max_off_step * rg.my_rand(dt, random::normal())), 0.7f, 1.3f);
-        }
-        
-        amp_next = amps[index];
-        rate = durs[index];
-        rat_next = rats[index];
-
-        off = off_next;
-        off_next = offs[index];
-    
-        g_idx = g_idx_next;
-        g_idx_next = 0.0;
-
-        speed = freq * deltaTime * num_bpts;
-      }
-     
-      if (!is_fm_on) {
-        g_amp = amp + (env.get(g_idx) * sample.get(off));
-        g_amp_next = amp_next + (env.get(g_idx_next) * sample.get(off_next));
-        amp_out = ((1.0 - phase) * g_amp) + (phase * g_amp_next); 
-      } else {
-        g_amp = amp + (env.get(g_idx) * sinf(phase_car1));
-        g_amp_next = amp_next + (env.get(g_idx_next) * sinf(phase_car2));
-        amp_out = ((1.0 - phase) * g_amp) + (phase * g_amp_next); 
-      }
-
-      g_idx = fmod(g_idx + (g_rate * deltaTime), 1.f);
-      g_idx_next = fmod(g_idx_next + (g_rate * deltaTime), 1.f);
-
-      off = fmod(off + (g_rate * deltaTime), 1.f);
-      off_next = fmod(off_next + (g_rate * deltaTime), 1.f);
-      
-      phase += speed;
-
-      phase_car1 += deltaTime * f_car1 * rat;
-      phase_car2 += deltaTime * f_car2 * rat_next;
-
-      phase_car1 = fmod(phase_car1, 1.f);
-      phase_car2 = fmod(phase_car2, 1.f);
-
-      phase_mod1 += deltaTime * f_mod;
-      phase_mod2 += deltaTime * f_mod;
-
-      phase_mod1 = fmod(phase_mod1, 1.f);
-      phase_mod2 = fmod(phase_mod2, 1.f);
-
-      f_car1 = fmod(f_car + (i_mod * sample.get(phase_mod1)), 22050.f);
-      f_car2 = fmod(f_car + (i_mod * sample.get(phase_mod2)), 22050.f);
-    
-      count++;
-    }
-
-    float wrap(float in, float lb, float ub) {
-      float out = in;
-      if (in > ub) out = lb;
-      else if (in < lb) out = ub;
-      return out;
-    }
-
-    float mirror(float in, float lb, float ub) {
-      float out = in;
-      if (in > ub) {
-        out = ub - (in - ub);
-      }
-      else if (in < lb) {
-        out = lb + (lb - in);
-      }
-      return out;
-    }
-    
-    float out() {
-      return amp_out;
-    }
-  };
-}
+#include "../utils/GrandyOscillator.hpp"
+#include "../utils/wavetable.cpp"
 
 using namespace rack;
 
@@ -405,35 +55,63 @@ bool float_equal(float a, float b, float epsilon = 1e-5f) {
     return std::fabs(a - b) < epsilon;
 }
 
+// True when every lane of x is finite
+bool all_finite(float_4 x) {
+    for (int i = 0; i < 4; i++) {
+        if (!std::isfinite(x[i]))
+            return false;
+    }
+    return true;
+}
+
+// True when every lane of osc sat on a segment, phase in [0, 1), during
+// the last sample. process() steps the phase on after the output, the
+// breakpoint it reaches is taken at the start of the next sample.
+bool phase_on_segment(const GendyOscillator& osc) {
+    for (int i = 0; i < 4; i++) {
+        float p = osc.phase[i] - osc.speed[i];
+        if (!(p >= -1e-6f && p < 1.0f))
+            return false;
+    }
+    return true;
+}
+
+const float SAMPLE_TIME = 1.0f / 44100.0f;
+
 // ============================================================================
 // GendyOscillator initialization tests
 // ============================================================================
 
 bool test_oscillator_default_initialization() {
     GendyOscillator osc;
-    TEST_ASSERT(osc.phase == 1.0f, "Default phase should be 1.0");
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT(osc.phase[i] == 1.0f, "Default phase should be 1.0");
+        TEST_ASSERT(osc.num_bpts[i] == 12, "Default number of breakpoints should be 12");
+    }
     TEST_ASSERT(osc.GRAN_ON == true, "Granulation should be on by default");
     TEST_ASSERT(osc.is_fm_on == true, "FM should be on by default");
     TEST_ASSERT(osc.is_mirroring == false, "Mirroring should be off by default");
-    TEST_ASSERT(osc.num_bpts == 12, "Default number of breakpoints should be 12");
     TEST_ASSERT(osc.min_freq == 30, "Default min frequency should be 30");
     TEST_ASSERT(osc.max_freq == 1000, "Default max frequency should be 1000");
+    TEST_ASSERT(osc.sample == WavetableRegistry::get(SIN), "Sample table should be the shared SIN table");
+    TEST_ASSERT(osc.env == WavetableRegistry::get(TRI), "Envelope should be the shared TRI table");
     return true;
 }
 
 bool test_oscillator_initial_arrays() {
     GendyOscillator osc;
-    TEST_ASSERT(osc.amps[0] == 0.0f, "Initial amplitude should be 0");
-    TEST_ASSERT(osc.durs[0] == 1.0f, "Initial duration should be 1.0");
-    TEST_ASSERT(osc.offs[0] == 0.0f, "Initial offset should be 0");
-    TEST_ASSERT(osc.rats[0] == 1.0f, "Initial rate should be 1.0");
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT(osc.amps[0][i] == 0.0f, "Initial amplitude should be 0");
+        TEST_ASSERT(osc.durs[0][i] == 1.0f, "Initial duration should be 1.0");
+        TEST_ASSERT(osc.offs[0][i] == 0.0f, "Initial offset should be 0");
+        TEST_ASSERT(osc.rats[0][i] == 1.0f, "Initial rate should be 1.0");
+    }
     return true;
 }
 
 bool test_oscillator_initial_output() {
     GendyOscillator osc;
-    float output = osc.out();
-    TEST_ASSERT(!std::isnan(output) && !std::isinf(output), "Initial output should be valid");
+    TEST_ASSERT(all_finite(osc.out()), "Initial output should be valid");
     return true;
 }
 
@@ -466,7 +144,7 @@ bool test_oscillator_wrap_negative_range() {
     GendyOscillator osc;
     float result1 = osc.wrap(1.5f, -1.0f, 1.0f);
     TEST_ASSERT(float_equal(result1, -1.0f), "wrap() should work with negative ranges");
-    
+
     float result2 = osc.wrap(-1.5f, -1.0f, 1.0f);
     TEST_ASSERT(float_equal(result2, 1.0f), "wrap() should wrap correctly in negative range");
     return true;
@@ -512,38 +190,38 @@ bool test_oscillator_mirror_extreme_values() {
 bool test_oscillator_process_basic() {
     GendyOscillator osc;
     osc.phase = 0.5f;
-    float deltaTime = 0.001f;
-    float initial_phase = osc.phase;
-    
-    osc.process(deltaTime);
-    
-    TEST_ASSERT(!std::isnan(osc.amp_out) && !std::isinf(osc.amp_out), "process() should produce valid output");
-    // Phase may wrap around, so check if it changed or is valid
-    TEST_ASSERT(osc.phase >= 0.0f && osc.phase < 1.0f, "process() should keep phase in valid range");
+
+    osc.process(SAMPLE_TIME);
+
+    TEST_ASSERT(all_finite(osc.amp_out), "process() should produce valid output");
+    TEST_ASSERT(phase_on_segment(osc), "process() should keep phase in valid range");
     return true;
 }
 
 bool test_oscillator_process_phase_wraparound() {
     GendyOscillator osc;
-    osc.phase = 0.99f;
-    float deltaTime = 0.1f;
-    
-    osc.process(deltaTime);
-    
-    TEST_ASSERT(osc.phase >= 0.0f && osc.phase < 1.0f, "Phase should wrap around when >= 1.0");
+
+    // phase starts at 1.0, so the first sample steps onto a breakpoint
+    // and sets the speed, the following ones run through a cycle
+    int wraps = 0;
+    for (int t = 0; t < 2000; t++) {
+        float before = osc.phase[0];
+        osc.process(SAMPLE_TIME);
+        TEST_ASSERT(phase_on_segment(osc), "Phase should wrap around when >= 1.0");
+        wraps += osc.phase[0] < before;
+    }
+    TEST_ASSERT(wraps >= 12, "Phase should wrap once per breakpoint");
     return true;
 }
 
 bool test_oscillator_process_multiple_steps() {
     GendyOscillator osc;
-    osc.phase = 0.0f;
-    float deltaTime = 0.001f;
-    
+
     for (int i = 0; i < 100; i++) {
-        osc.process(deltaTime);
-        TEST_ASSERT(!std::isnan(osc.amp_out) && !std::isinf(osc.amp_out), 
+        osc.process(SAMPLE_TIME);
+        TEST_ASSERT(all_finite(osc.amp_out),
                     "Output should remain valid after multiple process calls");
-        TEST_ASSERT(osc.phase >= 0.0f && osc.phase < 1.0f, 
+        TEST_ASSERT(phase_on_segment(osc),
                     "Phase should stay in valid range");
     }
     return true;
@@ -551,51 +229,56 @@ bool test_oscillator_process_multiple_steps() {
 
 bool test_oscillator_process_zero_deltatime() {
     GendyOscillator osc;
-    float initial_phase = osc.phase;
-    
+
     osc.process(0.0f);
-    
-    TEST_ASSERT(!std::isnan(osc.amp_out), "process() should handle zero deltaTime");
+
+    TEST_ASSERT(all_finite(osc.amp_out), "process() should handle zero deltaTime");
     return true;
 }
 
 bool test_oscillator_process_large_deltatime() {
     GendyOscillator osc;
-    osc.phase = 0.0f;
-    
-    osc.process(1.0f);
-    
-    TEST_ASSERT(!std::isnan(osc.amp_out) && !std::isinf(osc.amp_out), 
-                "process() should handle large deltaTime");
+
+    // a second per sample puts thousands of breakpoints in every sample
+    for (int t = 0; t < 4; t++)
+        osc.process(1.0f);
+
+    TEST_ASSERT(all_finite(osc.amp_out), "process() should handle large deltaTime");
+    TEST_ASSERT(phase_on_segment(osc), "Skipped segments should leave phase in range");
     return true;
 }
 
 bool test_oscillator_process_index_progression() {
     GendyOscillator osc;
-    osc.phase = 0.99f;
-    osc.index = 5;
-    float deltaTime = 0.1f;
-    
-    int initial_index = osc.index;
-    osc.process(deltaTime);
-    
-    TEST_ASSERT(osc.index >= 0 && osc.index < osc.num_bpts, 
-                "Index should stay within valid range");
+    for (int i = 0; i < 4; i++)
+        osc.index[i] = 5;
+
+    for (int t = 0; t < 1000; t++) {
+        osc.process(SAMPLE_TIME);
+        for (int i = 0; i < 4; i++) {
+            TEST_ASSERT(osc.index[i] >= 0 && osc.index[i] < osc.num_bpts[i],
+                        "Index should stay within valid range");
+        }
+    }
     return true;
 }
 
 bool test_oscillator_process_last_flag() {
     GendyOscillator osc;
-    osc.phase = 0.99f;
-    osc.index = osc.num_bpts - 2;  // Second to last
-    float deltaTime = 0.1f;
-    
-    osc.process(deltaTime);
-    
-    // After processing, if we hit the last breakpoint, last_flag should be true
-    // This test verifies the flag mechanism works
-    TEST_ASSERT(osc.last_flag == true || osc.last_flag == false, 
-                "last_flag should be a valid boolean");
+    osc.phase = 1.0f;
+    for (int i = 0; i < 4; i++)
+        osc.index[i] = osc.num_bpts[i] - 2;  // Second to last
+
+    osc.process(SAMPLE_TIME);
+
+    // every lane reached its last breakpoint in this sample
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT(osc.index[i] == osc.num_bpts[i] - 1, "Index should step onto the last breakpoint");
+        TEST_ASSERT(osc.last_flag[i] == true, "last_flag should be set on the last breakpoint");
+    }
+
+    osc.process(SAMPLE_TIME);
+    TEST_ASSERT(osc.last_flag[0] == false, "last_flag should only last one sample");
     return true;
 }
 
@@ -605,30 +288,32 @@ bool test_oscillator_process_last_flag() {
 
 bool test_oscillator_out_returns_valid() {
     GendyOscillator osc;
-    osc.process(0.001f);
-    float output = osc.out();
-    
-    TEST_ASSERT(!std::isnan(output) && !std::isinf(output), "out() should return valid value");
+    osc.process(SAMPLE_TIME);
+
+    TEST_ASSERT(all_finite(osc.out()), "out() should return valid value");
     return true;
 }
 
 bool test_oscillator_out_matches_amp_out() {
     GendyOscillator osc;
-    osc.process(0.001f);
-    
-    TEST_ASSERT(float_equal(osc.out(), osc.amp_out), "out() should return amp_out value");
+    osc.process(SAMPLE_TIME);
+
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT(float_equal(osc.out()[i], osc.amp_out[i]), "out() should return amp_out value");
+    }
     return true;
 }
 
 bool test_oscillator_out_reasonable_range() {
     GendyOscillator osc;
-    
+
     for (int i = 0; i < 1000; i++) {
-        osc.process(0.001f);
-        float output = osc.out();
-        // Output should be finite (granular synthesis can have wide dynamic range)
-        TEST_ASSERT(!std::isnan(output) && !std::isinf(output), 
-                    "Output should be finite");
+        osc.process(SAMPLE_TIME);
+        // amplitude breakpoints stay in [-1, 1] and the grains add at
+        // most one more on top
+        for (int k = 0; k < 4; k++) {
+            TEST_ASSERT(std::fabs(osc.out()[k]) <= 2.0f, "Output should stay within +-2");
+        }
     }
     return true;
 }
@@ -639,50 +324,60 @@ bool test_oscillator_out_reasonable_range() {
 
 bool test_oscillator_fm_on_off() {
     GendyOscillator osc1;
+    osc1.seed(7);
     osc1.is_fm_on = true;
-    osc1.process(0.001f);
-    float output1 = osc1.out();
-    
+
     GendyOscillator osc2;
+    osc2.seed(7);
     osc2.is_fm_on = false;
-    osc2.process(0.001f);
-    float output2 = osc2.out();
-    
-    TEST_ASSERT(!std::isnan(output1) && !std::isnan(output2), 
-                "Both FM on and off should produce valid output");
+
+    bool differ = false;
+    for (int t = 0; t < 1000; t++) {
+        osc1.process(SAMPLE_TIME);
+        osc2.process(SAMPLE_TIME);
+        TEST_ASSERT(all_finite(osc1.out()) && all_finite(osc2.out()),
+                    "Both FM on and off should produce valid output");
+        differ |= osc1.out()[0] != osc2.out()[0];
+    }
+    TEST_ASSERT(differ, "FM mode should change the grain content");
     return true;
 }
 
 bool test_oscillator_mirroring_on_off() {
     GendyOscillator osc1;
+    osc1.seed(7);
     osc1.is_mirroring = true;
-    osc1.phase = 0.99f;
-    osc1.process(0.1f);
-    
+
     GendyOscillator osc2;
+    osc2.seed(7);
     osc2.is_mirroring = false;
-    osc2.phase = 0.99f;
-    osc2.process(0.1f);
-    
-    TEST_ASSERT(!std::isnan(osc1.out()) && !std::isnan(osc2.out()), 
+
+    for (int t = 0; t < 5000; t++) {
+        osc1.process(SAMPLE_TIME);
+        osc2.process(SAMPLE_TIME);
+    }
+
+    TEST_ASSERT(all_finite(osc1.out()) && all_finite(osc2.out()),
                 "Both mirroring modes should produce valid output");
     return true;
 }
 
 bool test_oscillator_different_num_breakpoints() {
     std::vector<int> breakpoint_counts = {3, 12, 25, MAX_BPTS};
-    
+
     for (int num_bpts : breakpoint_counts) {
         GendyOscillator osc;
-        osc.num_bpts = num_bpts;
-        osc.phase = 0.0f;
-        
-        for (int i = 0; i < 100; i++) {
-            osc.process(0.001f);
-            TEST_ASSERT(!std::isnan(osc.out()), 
+        for (int i = 0; i < 4; i++)
+            osc.num_bpts[i] = num_bpts;
+
+        for (int t = 0; t < 1000; t++) {
+            osc.process(SAMPLE_TIME);
+            TEST_ASSERT(all_finite(osc.out()),
                         "Should work with different breakpoint counts");
-            TEST_ASSERT(osc.index >= 0 && osc.index < num_bpts,
-                        "Index should stay within breakpoint range");
+            for (int i = 0; i < 4; i++) {
+                TEST_ASSERT(osc.index[i] >= 0 && osc.index[i] < num_bpts,
+                            "Index should stay within breakpoint range");
+            }
         }
     }
     return true;
@@ -691,30 +386,30 @@ bool test_oscillator_different_num_breakpoints() {
 bool test_oscillator_frequency_change() {
     GendyOscillator osc;
     osc.freq = 440.0f;  // A4
-    osc.process(0.001f);
-    float output1 = osc.out();
-    
+    osc.process(SAMPLE_TIME);
+    TEST_ASSERT(float_equal(osc.speed[0], 440.0f * SAMPLE_TIME * 12), "Speed should follow the frequency");
+
     osc.freq = 880.0f;  // A5
-    osc.process(0.001f);
-    float output2 = osc.out();
-    
-    TEST_ASSERT(!std::isnan(output1) && !std::isnan(output2), 
-                "Should handle frequency changes");
+    for (int t = 0; t < 1000; t++)
+        osc.process(SAMPLE_TIME);
+
+    TEST_ASSERT(all_finite(osc.out()), "Should handle frequency changes");
+    TEST_ASSERT(float_equal(osc.speed[0], 880.0f * SAMPLE_TIME * 12), "Speed should change at the next breakpoint");
     return true;
 }
 
 bool test_oscillator_step_parameters() {
     GendyOscillator osc;
-    
+
     osc.max_amp_step = 0.1f;
     osc.max_dur_step = 0.1f;
     osc.max_off_step = 0.01f;
     osc.max_rat_step = 0.02f;
-    
-    osc.phase = 0.99f;
-    osc.process(0.1f);
-    
-    TEST_ASSERT(!std::isnan(osc.out()), "Should handle different step parameters");
+
+    for (int t = 0; t < 1000; t++)
+        osc.process(SAMPLE_TIME);
+
+    TEST_ASSERT(all_finite(osc.out()), "Should handle different step parameters");
     return true;
 }
 
@@ -724,15 +419,40 @@ bool test_oscillator_step_parameters() {
 
 bool test_oscillator_extreme_frequencies() {
     GendyOscillator osc1;
-    osc1.freq = 20.0f;  // Very low
-    osc1.process(0.001f);
-    TEST_ASSERT(!std::isnan(osc1.out()), "Should handle very low frequency");
-    
+    osc1.freq = 1.0f;  // Very low
+    for (int t = 0; t < 1000; t++)
+        osc1.process(SAMPLE_TIME);
+    TEST_ASSERT(all_finite(osc1.out()), "Should handle very low frequency");
+
     GendyOscillator osc2;
-    osc2.freq = 20000.0f;  // Very high
-    osc2.process(0.001f);
-    TEST_ASSERT(!std::isnan(osc2.out()), "Should handle very high frequency");
-    
+    osc2.freq = 3000.0f;  // Highest the module sets, 36 kHz of segments
+    for (int t = 0; t < 1000; t++)
+        osc2.process(SAMPLE_TIME);
+    TEST_ASSERT(all_finite(osc2.out()), "Should handle very high frequency");
+
+    return true;
+}
+
+bool test_oscillator_segment_cap() {
+    GendyOscillator osc;
+    osc.freq = 20000.0f;  // 22.7 segments per sample with 50 breakpoints
+    for (int i = 0; i < 4; i++)
+        osc.num_bpts[i] = MAX_BPTS;
+
+    osc.process(SAMPLE_TIME);
+    TEST_ASSERT(float_equal(osc.speed[0], (float) MAX_SEGMENTS_PER_SAMPLE),
+                "Speed should be clamped to MAX_SEGMENTS_PER_SAMPLE");
+
+    // every breakpoint the phase passes is stepped onto, none skipped
+    int passed = 0;
+    for (int t = 0; t < 1000; t++) {
+        int before = osc.index[0];
+        osc.process(SAMPLE_TIME);
+        passed += (osc.index[0] - before + MAX_BPTS) % MAX_BPTS;
+        TEST_ASSERT(phase_on_segment(osc), "Phase should stay on a segment");
+    }
+    TEST_ASSERT(passed == 1000 * MAX_SEGMENTS_PER_SAMPLE,
+                "Each sample should pass exactly MAX_SEGMENTS_PER_SAMPLE breakpoints");
     return true;
 }
 
@@ -742,45 +462,50 @@ bool test_oscillator_fm_parameters() {
     osc.f_mod = 200.0f;
     osc.f_car = 800.0f;
     osc.i_mod = 50.0f;
-    
+
     for (int i = 0; i < 100; i++) {
-        osc.process(0.001f);
-        TEST_ASSERT(!std::isnan(osc.out()), "FM synthesis should produce valid output");
+        osc.process(SAMPLE_TIME);
+        TEST_ASSERT(all_finite(osc.out()), "FM synthesis should produce valid output");
     }
     return true;
 }
 
 bool test_oscillator_wavetable_switching() {
     GendyOscillator osc;
-    
+
     // Switch sample wavetable
-    osc.sample.switchEnvType(TRI);
-    osc.process(0.001f);
-    TEST_ASSERT(!std::isnan(osc.out()), "Should work with TRI sample wavetable");
-    
-    osc.sample.switchEnvType(HANN);
-    osc.process(0.001f);
-    TEST_ASSERT(!std::isnan(osc.out()), "Should work with HANN sample wavetable");
-    
-    // Switch envelope wavetable
-    osc.env.switchEnvType(WELCH);
-    osc.process(0.001f);
-    TEST_ASSERT(!std::isnan(osc.out()), "Should work with WELCH envelope");
-    
+    osc.is_fm_on = false;
+    osc.sample = WavetableRegistry::get(TRI);
+    osc.process(SAMPLE_TIME);
+    TEST_ASSERT(all_finite(osc.out()), "Should work with TRI sample wavetable");
+
+    osc.sample = WavetableRegistry::get(HANN);
+    osc.process(SAMPLE_TIME);
+    TEST_ASSERT(all_finite(osc.out()), "Should work with HANN sample wavetable");
+
+    // Switch envelope wavetable, at once and with a crossfade
+    osc.setEnvelope(WavetableRegistry::get(WELCH), 0);
+    osc.process(SAMPLE_TIME);
+    TEST_ASSERT(all_finite(osc.out()), "Should work with WELCH envelope");
+    TEST_ASSERT(osc.env_fade == 0.0f, "An immediate switch should not fade");
+
+    osc.setEnvelope(WavetableRegistry::get(TUKEY), 100);
+    for (int t = 0; t < 100; t++)
+        osc.process(SAMPLE_TIME);
+    TEST_ASSERT(osc.env == WavetableRegistry::get(TUKEY), "Should switch to the TUKEY envelope");
+    TEST_ASSERT(osc.env_fade <= 1e-5f, "The crossfade should be over after its length");
+
     return true;
 }
 
 bool test_oscillator_distribution_types() {
-    std::vector<DistType> dist_types = {LINEAR, CAUCHY, ARCSINE};
-    
-    for (DistType dt : dist_types) {
+    for (int d = 0; d < NUM_DISTS; d++) {
         GendyOscillator osc;
-        osc.dt = dt;
-        osc.phase = 0.99f;
-        
-        for (int i = 0; i < 50; i++) {
-            osc.process(0.01f);
-            TEST_ASSERT(!std::isnan(osc.out()), 
+        osc.dt = (DistType) d;
+
+        for (int i = 0; i < 500; i++) {
+            osc.process(SAMPLE_TIME);
+            TEST_ASSERT(all_finite(osc.out()),
                         "Should work with all distribution types");
         }
     }
@@ -789,16 +514,15 @@ bool test_oscillator_distribution_types() {
 
 bool test_oscillator_continuous_operation() {
     GendyOscillator osc;
-    osc.phase = 0.0f;
-    
+
     // Run for many cycles
-    for (int i = 0; i < 10000; i++) {
-        osc.process(0.001f);
-        
+    for (int i = 0; i < 100000; i++) {
+        osc.process(SAMPLE_TIME);
+
         if (i % 1000 == 0) {
-            TEST_ASSERT(!std::isnan(osc.out()) && !std::isinf(osc.out()), 
+            TEST_ASSERT(all_finite(osc.out()),
                         "Should maintain valid output over long operation");
-            TEST_ASSERT(osc.phase >= 0.0f && osc.phase < 1.0f,
+            TEST_ASSERT(phase_on_segment(osc),
                         "Phase should remain valid over long operation");
         }
     }
@@ -809,14 +533,110 @@ bool test_oscillator_state_consistency() {
     GendyOscillator osc;
     osc.phase = 0.5f;
     int initial_count = osc.count;
-    
-    osc.process(0.001f);
-    
+
+    osc.process(SAMPLE_TIME);
+
+    // no breakpoint in this sample, so the grain indices only advance by
+    // one step of g_rate
+    const uint32_t step = GendyOscillator::toPhase(osc.g_rate[0] * SAMPLE_TIME);
     TEST_ASSERT(osc.count == initial_count + 1, "Count should increment each process call");
-    TEST_ASSERT(osc.phase >= 0.0f && osc.phase < 1.0f, "Phase should be valid");
-    TEST_ASSERT(osc.g_idx >= 0.0f && osc.g_idx <= 1.0f, "Grain index should be valid");
-    TEST_ASSERT(osc.g_idx_next >= 0.0f && osc.g_idx_next <= 1.0f, "Next grain index should be valid");
-    
+    TEST_ASSERT(phase_on_segment(osc), "Phase should be valid");
+    TEST_ASSERT(osc.g_idx[0] == step, "Grain index should advance by one step");
+    TEST_ASSERT(osc.g_idx_next[0] == GendyOscillator::HALF_PHASE + step, "Next grain index should advance by one step");
+
+    return true;
+}
+
+// ============================================================================
+// Seed and block tests
+// ============================================================================
+
+bool test_oscillator_seed_repeats_walk() {
+    GendyOscillator a, b;
+    a.seed(1234);
+    b.seed(1234);
+
+    bool same = true;
+    for (int t = 0; t < 10000; t++) {
+        a.process(SAMPLE_TIME);
+        b.process(SAMPLE_TIME);
+        for (int i = 0; i < 4; i++)
+            same &= a.out()[i] == b.out()[i];
+    }
+    TEST_ASSERT(same, "The same seed should give the same output");
+    return true;
+}
+
+bool test_oscillator_lanes_independent() {
+    GendyOscillator osc;
+    osc.seed(5);
+    osc.freq = 440.0f;
+
+    bool differ = false;
+    for (int t = 0; t < 5000; t++) {
+        osc.process(SAMPLE_TIME);
+        differ |= osc.out()[0] != osc.out()[1];
+    }
+    TEST_ASSERT(differ, "Lanes at the same frequency should walk independently");
+    return true;
+}
+
+bool test_oscillator_block_matches_samples() {
+    GendyOscillator a, b;
+    a.seed(99);
+    b.seed(99);
+
+    float_4 block[32];
+    bool same = true;
+    for (int n = 0; n < 100; n++) {
+        a.processBlock(block, 32, SAMPLE_TIME);
+        for (int t = 0; t < 32; t++) {
+            b.process(SAMPLE_TIME);
+            for (int i = 0; i < 4; i++)
+                same &= block[t][i] == b.out()[i];
+        }
+    }
+    TEST_ASSERT(same, "A block should match the same samples one at a time");
+    return true;
+}
+
+// ============================================================================
+// Xoshiro128x4 tests
+// ============================================================================
+
+bool test_xoshiro_uniform_range() {
+    Xoshiro128x4 rng(11);
+    double sum = 0.0;
+    bool in_range = true;
+    const int n = 100000;
+
+    for (int t = 0; t < n; t++) {
+        float_4 u = rng.uniform4();
+        for (int k = 0; k < 4; k++) {
+            in_range &= u[k] >= 0.0f && u[k] < 1.0f;
+            sum += u[k];
+        }
+    }
+    TEST_ASSERT(in_range, "Uniforms should lie in [0, 1)");
+    TEST_ASSERT(std::fabs(sum / (4.0 * n) - 0.5) < 0.005, "Mean of the uniforms should be 0.5");
+    return true;
+}
+
+bool test_xoshiro_seeds() {
+    Xoshiro128x4 a(3), b(3), c(4);
+
+    bool same = true, differ = false, streams = false;
+    for (int t = 0; t < 100; t++) {
+        float_4 ua = a.uniform4(), ub = b.uniform4(), uc = c.uniform4();
+        for (int k = 0; k < 4; k++) {
+            same &= ua[k] == ub[k];
+            differ |= ua[k] != uc[k];
+        }
+        streams |= ua[0] != ua[1];
+    }
+    TEST_ASSERT(same, "The same seed should repeat the streams");
+    TEST_ASSERT(differ, "Nearby seeds should give other streams");
+    TEST_ASSERT(streams, "The four streams should differ from each other");
     return true;
 }
 
@@ -876,6 +696,7 @@ int main() {
 
     std::cout << "--- Edge case and boundary tests ---" << std::endl;
     RUN_TEST(test_oscillator_extreme_frequencies);
+    RUN_TEST(test_oscillator_segment_cap);
     RUN_TEST(test_oscillator_fm_parameters);
     RUN_TEST(test_oscillator_wavetable_switching);
     RUN_TEST(test_oscillator_distribution_types);
@@ -883,6 +704,17 @@ int main() {
     RUN_TEST(test_oscillator_state_consistency);
     std::cout << std::endl;
 
+    std::cout << "--- Seed and block tests ---" << std::endl;
+    RUN_TEST(test_oscillator_seed_repeats_walk);
+    RUN_TEST(test_oscillator_lanes_independent);
+    RUN_TEST(test_oscillator_block_matches_samples);
+    std::cout << std::endl;
+
+    std::cout << "--- Xoshiro128x4 tests ---" << std::endl;
+    RUN_TEST(test_xoshiro_uniform_range);
+    RUN_TEST(test_xoshiro_seeds);
+    std::cout << std::endl;
+
     std::cout << "========================================" << std::endl;
     std::cout << "Test Results:" << std::endl;
     std::cout << "  Passed: " << tests_passed << std::endl;
@@ -0,0 +1,240 @@
+/*
+ * HalfBand_test.cpp
+ * Tests for the half-band decimators used by the oversampling modes
+ *
+ * Tests cover:
+ * - Unity gain at DC for every stage
+ * - Pass band and stop band of the 2x, 4x and 8x cascades
+ * - Priming the history with a constant
+ * - Group delay of every factor against DecimatorCascade::delay()
+ * - Factor changes of SwitchingDecimator without a step
+ *
+ * Compiles the real header against the mock SDK in mock/.
+ */
+
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+
+#include "../utils/HalfBand.hpp"
+
+using namespace rack;
+
+// Test utilities
+namespace TestUtils
+{
+  void assertTrue(bool condition, const std::string& message)
+  {
+    if (!condition)
+    {
+      std::cerr << "FAIL: " << message << std::endl;
+      assert(false);
+    }
+  }
+
+  void assertNear(float expected, float actual, float tolerance, const std::string& message)
+  {
+    if (std::abs(expected - actual) > tolerance)
+    {
+      std::cerr << "FAIL: " << message << std::endl;
+      std::cerr << "  Expected: " << expected << ", Got: " << actual << std::endl;
+      assert(false);
+    }
+  }
+}
+
+using namespace TestUtils;
+
+/*
+ * Steady-state gain of a cascade at the given factor for a sine of freq
+ * cycles per output sample, from the RMS after the filters settled
+ */
+float cascadeGain(int factor, float freq)
+{
+  DecimatorCascade cascade;
+  cascade.reset();
+
+  const int blockSize = 32;
+  std::vector<simd::float_4> buf(blockSize * factor);
+  long n = 0;
+  double sum = 0.0;
+  int count = 0;
+
+  for (int block = 0; block < 200; block++)
+  {
+    for (int t = 0; t < blockSize * factor; t++, n++)
+      buf[t] = std::sin(2.0 * M_PI * freq * n / factor);
+    cascade.process(buf.data(), blockSize, factor);
+
+    // the longest cascade has settled after a few blocks
+    if (block >= 20)
+      for (int t = 0; t < blockSize; t++, count++)
+        sum += buf[t][0] * buf[t][0];
+  }
+  return std::sqrt(2.0 * sum / count);
+}
+
+void testDcGain()
+{
+  std::cout << "Testing gain at DC..." << std::endl;
+
+  HalfBandDecimator<4> stage8;
+  HalfBandDecimator<5> stage4;
+  HalfBandDecimator<14> stage2;
+  stage8.reset();
+  stage4.reset();
+  stage2.reset();
+
+  simd::float_4 y8, y4, y2;
+  for (int t = 0; t < 100; t++)
+  {
+    y8 = stage8.process(1.f, 1.f);
+    y4 = stage4.process(1.f, 1.f);
+    y2 = stage2.process(1.f, 1.f);
+  }
+
+  assertNear(1.f, y8[0], 1e-5f, "8x -> 4x stage should pass DC unchanged");
+  assertNear(1.f, y4[0], 1e-5f, "4x -> 2x stage should pass DC unchanged");
+  assertNear(1.f, y2[0], 1e-5f, "2x -> 1x stage should pass DC unchanged");
+
+  std::cout << "  ✓ DC gain test passed" << std::endl;
+}
+
+void testPassAndStopBand()
+{
+  std::cout << "Testing pass band and stop band..." << std::endl;
+
+  const int factors[] = {2, 4, 8};
+  for (int factor : factors)
+  {
+    // 0.1 of the output rate is 4.4 kHz at 44.1 kHz
+    float pass = cascadeGain(factor, 0.1f);
+    // above the output Nyquist frequency, it would alias back
+    float stop = cascadeGain(factor, 0.75f);
+
+    std::cout << "  " << factor << "x: pass band " << pass << ", stop band "
+              << 20.f * std::log10(stop) << " dB" << std::endl;
+    assertNear(1.f, pass, 1e-3f, "Pass band should be flat");
+    assertTrue(stop < 1e-3f, "Stop band should be at least 60 dB down");
+  }
+
+  std::cout << "  ✓ Band test passed" << std::endl;
+}
+
+void testPrime()
+{
+  std::cout << "Testing priming with a constant..." << std::endl;
+
+  HalfBandDecimator<14> stage;
+  stage.prime(0.7f);
+
+  // a primed stage behaves as if it had always seen the constant
+  simd::float_4 y = stage.process(0.7f, 0.7f);
+  for (int i = 0; i < 4; i++)
+    assertNear(0.7f, y[i], 1e-5f, "Primed stage should output the constant at once");
+
+  std::cout << "  ✓ Prime test passed" << std::endl;
+}
+
+void testDelay()
+{
+  std::cout << "Testing group delay..." << std::endl;
+
+  const int factors[] = {1, 2, 4, 8};
+  for (int factor : factors)
+  {
+    // centroid of the response to an impulse at output time at, input
+    // sample at * factor
+    DecimatorCascade cascade;
+    cascade.reset();
+
+    const int n = 64, at = 8;
+    std::vector<simd::float_4> buf(n * factor, simd::float_4(0.f));
+    buf[at * factor] = 1.f;
+    cascade.process(buf.data(), n, factor);
+
+    double sum = 0.0, moment = 0.0;
+    for (int t = 0; t < n; t++)
+    {
+      sum += buf[t][0];
+      moment += t * buf[t][0];
+    }
+
+    std::cout << "  " << factor << "x: " << moment / sum - at << " samples" << std::endl;
+    assertNear(DecimatorCascade::delay(factor), moment / sum - at, 1e-3f, "Group delay should match delay()");
+  }
+
+  std::cout << "  ✓ Delay test passed" << std::endl;
+}
+
+void testSwitchingDecimator()
+{
+  std::cout << "Testing factor changes without a step..." << std::endl;
+
+  const int blockSize = 32;
+  const int factors[] = {1, 2, 8, 4, 1, 8, 2};
+  SwitchingDecimator decimator;
+  decimator.reset();
+
+  std::vector<simd::float_4> buf(blockSize * 8), scratch(blockSize * 8);
+  long n = 0;
+  float last = 0.f, worstStep = 0.f;
+
+  for (int f : factors)
+  {
+    for (int block = 0; block < 50; block++)
+    {
+      // a slow sine, consecutive output samples are close
+      decimator.setFactor(f, std::sin(2.0 * M_PI * 0.002 * (n - 1.0 / decimator.factor)));
+      for (int t = 0; t < blockSize * f; t++)
+        buf[t] = std::sin(2.0 * M_PI * 0.002 * (n + (double) t / f));
+      n += blockSize;
+
+      decimator.process(buf.data(), blockSize, scratch.data());
+      for (int t = 0; t < blockSize; t++)
+      {
+        if (n > blockSize * 10)
+          worstStep = std::max(worstStep, std::abs(buf[t][0] - last));
+        last = buf[t][0];
+      }
+    }
+  }
+
+  // the largest step of the sine itself is 2 pi 0.002 = 0.0126
+  std::cout << "  largest step " << worstStep << std::endl;
+  assertTrue(worstStep < 0.02f, "Factor changes should not step the output");
+
+  std::cout << "  ✓ Switching test passed" << std::endl;
+}
+
+// Main test runner
+int main()
+{
+  std::cout << "========================================" << std::endl;
+  std::cout << "Running HalfBand Decimator Tests" << std::endl;
+  std::cout << "========================================" << std::endl << std::endl;
+
+  try
+  {
+    testDcGain();
+    testPassAndStopBand();
+    testPrime();
+    testDelay();
+    testSwitchingDecimator();
+
+    std::cout << std::endl << "========================================" << std::endl;
+    std::cout << "All tests passed! ✓" << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    return 0;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << std::endl << "Test failed with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -11,6 +11,10 @@
  * - Automatic makeup gain
  * - Hard clipping protection
  * - Signal fidelity at safe levels
+ * - Sliding-window peak detector exactness and speed
+ * - Power-of-two delay line against a modulo ring
+ * - Linear-domain gain computer against the dB formulas
+ * - Lookahead settings, their latency and switching between them
  */
 
 #include <iostream>
@@ -19,6 +23,8 @@
 #include <vector>
 #include <string>
 #include <cstdlib>
+#include <chrono>
+#include <iomanip>
 
 // Define M_PI if not already defined (needed for Windows/MSVC)
 #ifndef M_PI
@@ -90,6 +96,86 @@ namespace TestUtils
 
 using namespace TestUtils;
 
+/**
+ * Reference peak detector: full scan of a ring buffer, as the limiter
+ * did before the sliding-window detector
+ */
+class ScanPeakDetector
+{
+private:
+  std::vector<float> buffer;
+  size_t writeIndex = 0;
+
+public:
+  explicit ScanPeakDetector(size_t windowSize) : buffer(windowSize, 0.0f) {}
+  
+  float process(float input)
+  {
+    buffer[writeIndex] = input;
+    writeIndex = (writeIndex + 1) % buffer.size();
+    
+    float peak = 0.0f;
+    for (size_t i = 0; i < buffer.size(); ++i)
+    {
+      float abs_sample = std::abs(buffer[i]);
+      if (abs_sample > peak)
+        peak = abs_sample;
+    }
+    return peak;
+  }
+};
+
+/**
+ * Reference delay line: ring of windowSize samples indexed modulo its
+ * size, as the limiter did before DelayLine
+ */
+class ModuloDelayLine
+{
+private:
+  std::vector<float> buffer;
+  size_t writeIndex = 0;
+
+public:
+  explicit ModuloDelayLine(size_t windowSize) : buffer(windowSize, 0.0f) {}
+  
+  float process(float input)
+  {
+    buffer[writeIndex] = input;
+    float output = buffer[(writeIndex + 1) % buffer.size()];
+    writeIndex = (writeIndex + 1) % buffer.size();
+    return output;
+  }
+};
+
+/**
+ * Reference gain computer: the soft and hard knee in dB with log10() and
+ * pow(), as the limiter did before GainComputer
+ */
+float referenceGain(float detectedLevel)
+{
+  if (detectedLevel < 1e-6f)
+    return 1.0f;
+  
+  float levelDb = 20.0f * std::log10(std::max(detectedLevel, 1e-6f));
+  float thresholdDb = 20.0f * std::log10(LIMITER_THRESHOLD);
+  float ceilingDb = 20.0f * std::log10(LIMITER_CEILING);
+  
+  float softKneeDb;
+  if (levelDb < thresholdDb - LIMITER_KNEE_WIDTH / 2.0f)
+    softKneeDb = levelDb;
+  else if (levelDb > thresholdDb + LIMITER_KNEE_WIDTH / 2.0f)
+    softKneeDb = thresholdDb;
+  else
+  {
+    float delta = levelDb - (thresholdDb - LIMITER_KNEE_WIDTH / 2.0f);
+    softKneeDb = levelDb - delta * delta / (2.0f * LIMITER_KNEE_WIDTH);
+  }
+  float hardKneeDb = std::min(levelDb, ceilingDb);
+  
+  float reductionDb = std::min(softKneeDb, hardKneeDb) - levelDb;
+  return std::max(std::pow(10.0f, reductionDb / 20.0f), MIN_GAIN_REDUCTION);
+}
+
 // Test functions
 void testInitialization()
 {
@@ -388,6 +474,253 @@ void testTransientHandling()
   std::cout << "  ✓ Transient handling test passed" << std::endl;
 }
 
+void testPeakDetectorMatchesScan()
+{
+  std::cout << "Testing sliding-window peak detector against full scan..." << std::endl;
+  
+  std::vector<size_t> windowSizes = {1, 2, 3, 220, 240, 960};
+  
+  for (size_t windowSize : windowSizes)
+  {
+    SlidingPeakDetector<LIMITER_MAX_DELAY> detector;
+    detector.init(windowSize);
+    ScanPeakDetector reference(windowSize);
+    
+    srand(1234);
+    for (int i = 0; i < 20000; ++i)
+    {
+      float input;
+      if (i % 5000 < 2000)
+      {
+        // Noise with occasional spikes and exact repeats
+        input = 8.0f * (static_cast<float>(rand()) / RAND_MAX - 0.5f);
+        if (i % 7 == 0)
+          input = -input;
+      }
+      else if (i % 5000 < 3000)
+      {
+        // Slowly decaying ramp, worst case for the deque
+        input = 6.0f - (i % 5000 - 2000) * 0.005f;
+      }
+      else
+      {
+        input = 2.0f * std::sin(2.0f * M_PI * 440.0f * i / 44100.0f);
+      }
+      
+      float expected = reference.process(input);
+      float actual = detector.process(input);
+      if (expected != actual)
+      {
+        std::cerr << "  Window " << windowSize << ", sample " << i << ": expected "
+                  << expected << ", got " << actual << std::endl;
+        assertTrue(false, "Sliding peak must match full scan exactly");
+      }
+    }
+    
+    // Reset must forget the history
+    detector.reset();
+    assertTrue(detector.process(0.0f) == 0.0f, "Reset detector should report silence");
+  }
+  
+  std::cout << "  ✓ Peak detector exactness test passed" << std::endl;
+}
+
+void testDelayLineMatchesModulo()
+{
+  std::cout << "Testing power-of-two delay line against modulo ring..." << std::endl;
+  
+  // Up to the 5 ms window at 768 kHz, runs wrap the 4096 ring many times
+  std::vector<size_t> windowSizes = {1, 2, 3, 220, 441, 960, 3841};
+  
+  for (size_t windowSize : windowSizes)
+  {
+    DelayLine<float, 4096> delayLine;
+    delayLine.setDelay(windowSize - 1);
+    ModuloDelayLine reference(windowSize);
+    
+    srand(99);
+    for (int i = 0; i < 50000; ++i)
+    {
+      float input = 8.0f * (static_cast<float>(rand()) / RAND_MAX - 0.5f);
+      float expected = reference.process(input);
+      float actual = delayLine.process(input);
+      if (expected != actual)
+      {
+        std::cerr << "  Window " << windowSize << ", sample " << i << ": expected "
+                  << expected << ", got " << actual << std::endl;
+        assertTrue(false, "Delay line must match the modulo ring exactly");
+      }
+    }
+    
+    delayLine.reset();
+    assertTrue(delayLine.process(1.0f) == (windowSize == 1 ? 1.0f : 0.0f), "Reset delay line should output silence");
+  }
+  
+  DelayLine<float, 4096> delayLine;
+  delayLine.setDelay(10000);
+  assertTrue(delayLine.getDelay() == 4095, "Delay should be clamped to the capacity");
+  
+  std::cout << "  ✓ Delay line test passed" << std::endl;
+}
+
+void testGainComputerMatchesDb()
+{
+  std::cout << "Testing gain computer against the dB formulas..." << std::endl;
+  
+  GainComputer gainComputer;
+  gainComputer.init();
+  
+  // Silence to far above the ceiling, densely through the knee
+  std::vector<float> levels;
+  for (int i = 0; i <= 2000; ++i)
+    levels.push_back(1e-7f * std::pow(10.0f, i * 0.005f));
+  for (int i = 0; i <= 20000; ++i)
+    levels.push_back(4.3f + i * 0.00002f);
+  
+  float worst = 0.0f;
+  for (float level : levels)
+    worst = std::max(worst, std::abs(gainComputer.process(level) - referenceGain(level)));
+  
+  std::cout << "  max difference " << worst << std::endl;
+  assertLess(worst, 1e-5f, "Gain should match the dB computer");
+  assertTrue(gainComputer.process(4.0f) == 1.0f, "Below the knee gain should be exactly unity");
+  
+  // the speed against the dB computer is timed by Restock_bench
+  std::cout << "  ✓ Gain computer test passed" << std::endl;
+}
+
+void testLookaheadSettings()
+{
+  std::cout << "Testing lookahead settings..." << std::endl;
+  
+  const float sampleRate = 48000.0f;
+  const float settings[] = {0.0f, 0.5f, 1.0f, 2.0f, 5.0f};
+  const size_t latencies[] = {0, 23, 47, 95, 239};
+  
+  for (int i = 0; i < 5; ++i)
+  {
+    // A setting made before init() applies without a fade
+    AudioLimiter limiter;
+    limiter.setLookahead(settings[i]);
+    limiter.init(sampleRate);
+    assertTrue(limiter.getLatency() == latencies[i], "Latency should follow the lookahead");
+    
+    // An impulse comes out after the reported latency
+    size_t peakIndex = 0;
+    float peak = 0.0f;
+    for (size_t t = 0; t < 1000; ++t)
+    {
+      float output = std::abs(limiter.process(t == 0 ? 1.0f : 0.0f));
+      if (output > peak)
+      {
+        peak = output;
+        peakIndex = t;
+      }
+    }
+    assertTrue(peakIndex == latencies[i], "Impulse should be delayed by the reported latency");
+    
+    // Every setting holds the ceiling, the clipper without any delay
+    limiter.init(sampleRate);
+    float maxOutput = 0.0f;
+    for (int t = 0; t < 48000; ++t)
+      maxOutput = std::max(maxOutput, std::abs(limiter.process(8.0f * std::sin(2.0f * M_PI * 330.0f * t / sampleRate))));
+    assertInRange(maxOutput, 3.0f, LIMITER_CEILING, "Every lookahead should hold the ceiling");
+  }
+  
+  AudioLimiter limiter;
+  limiter.setLookahead(20.0f);
+  assertFloatEquals(LOOKAHEAD_TIME_MS, limiter.getLookahead(), "Lookahead should be clamped to the longest one");
+  
+  std::cout << "  ✓ Lookahead settings test passed" << std::endl;
+}
+
+void testLookaheadSwitching()
+{
+  std::cout << "Testing lookahead switching..." << std::endl;
+  
+  const float sampleRate = 48000.0f;
+  const float settings[] = {0.0f, 5.0f, 0.5f, 2.0f, 0.0f, 1.0f, 5.0f};
+  
+  // Largest step between samples of a steady sine, then while the
+  // lookahead jumps between settings every 100 ms
+  float steadyStep = 0.0f, switchingStep = 0.0f;
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    AudioLimiter limiter;
+    limiter.init(sampleRate);
+    float previous = 0.0f;
+    for (int t = 0; t < 48000; ++t)
+    {
+      if (pass == 1 && t % 4800 == 2400)
+        limiter.setLookahead(settings[(t / 4800) % 7]);
+      
+      float output = limiter.process(3.0f * std::sin(2.0f * M_PI * 137.0f * t / sampleRate));
+      if (t > 2400)
+      {
+        float step = std::abs(output - previous);
+        if (pass == 0)
+          steadyStep = std::max(steadyStep, step);
+        else
+          switchingStep = std::max(switchingStep, step);
+      }
+      previous = output;
+    }
+  }
+  
+  std::cout << "  max step " << steadyStep << " V steady, " << switchingStep << " V switching" << std::endl;
+  assertLess(switchingStep, 1.5f * steadyStep, "Switching the lookahead should not click");
+  
+  std::cout << "  ✓ Lookahead switching test passed" << std::endl;
+}
+
+void benchmarkPeakDetection()
+{
+  std::cout << "Benchmarking peak detection (5 ms lookahead)..." << std::endl;
+  
+  typedef std::chrono::steady_clock Clock;
+  std::vector<float> sampleRates = {44100.0f, 96000.0f, 192000.0f};
+  const int numSamples = 200000;
+  
+  std::vector<float> signal(numSamples);
+  for (int i = 0; i < numSamples; ++i)
+    signal[i] = 6.0f * std::sin(2.0f * M_PI * 440.0f * i / 44100.0f) * std::sin(2.0f * M_PI * 3.0f * i / 44100.0f);
+  
+  for (float sampleRate : sampleRates)
+  {
+    size_t windowSize = static_cast<size_t>(5.0f * 0.001f * sampleRate);
+    volatile float sink = 0.0f;
+    
+    ScanPeakDetector scan(windowSize);
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < numSamples; ++i)
+      sink += scan.process(signal[i]);
+    double scanNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / numSamples;
+    
+    SlidingPeakDetector<LIMITER_MAX_DELAY> detector;
+    detector.init(windowSize);
+    start = Clock::now();
+    for (int i = 0; i < numSamples; ++i)
+      sink += detector.process(signal[i]);
+    double slidingNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / numSamples;
+    
+    AudioLimiter limiter;
+    limiter.init(sampleRate);
+    start = Clock::now();
+    for (int i = 0; i < numSamples; ++i)
+      sink += limiter.process(signal[i]);
+    double limiterNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / numSamples;
+    
+    std::cout << std::fixed << std::setprecision(1)
+              << "  " << sampleRate / 1000.0f << " kHz (window " << windowSize << "): "
+              << "scan " << scanNs << " ns/sample, sliding " << slidingNs << " ns/sample ("
+              << scanNs / slidingNs << "x), limiter " << limiterNs << " ns/sample" << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+  }
+  
+  // Timing is only reported, testPeakDetectorMatchesScan() checks the result
+  std::cout << "  ✓ Peak detection benchmark done" << std::endl;
+}
+
 // Main test runner
 int main()
 {
@@ -409,6 +742,12 @@ int main()
     testDifferentSampleRates();
     testContinuousSignal();
     testTransientHandling();
+    testPeakDetectorMatchesScan();
+    testDelayLineMatchesModulo();
+    testGainComputerMatchesDb();
+    testLookaheadSettings();
+    testLookaheadSwitching();
+    benchmarkPeakDetection();
     
     std::cout << std::endl << "========================================" << std::endl;
     std::cout << "All tests passed! ✓" << std::endl;
@@ -0,0 +1,442 @@
+/*
+ * ReGrandy_test.cpp
+ * Tests for the ReGrandy module as Rack runs it
+ *
+ * Tests cover:
+ * - Plugin init() and the module constructor
+ * - Mono and polyphonic output through process()
+ * - Every control rate, oversampling and limiter lookahead choice
+ * - Sample rate changes
+ * - dataToJson() / dataFromJson() round trip
+ * - Panel widget and context menu construction
+ * - Factory presets and seeded renders
+ * - Time per sample of the whole module
+ *
+ * plugin.cpp and ReGrandy.cpp are compiled as they ship, against the
+ * mock SDK in mock/, whose Module holds plain params and port voltages.
+ */
+
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <dirent.h>
+
+#include "../plugin.cpp"
+#include "../ReGrandy.cpp"
+#include "../utils/wavetable.cpp"
+
+// Test utilities
+namespace TestUtils
+{
+  void assertTrue(bool condition, const std::string& message)
+  {
+    if (!condition)
+    {
+      std::cerr << "FAIL: " << message << std::endl;
+      assert(false);
+    }
+  }
+
+  void assertEquals(int expected, int actual, const std::string& message)
+  {
+    if (expected != actual)
+    {
+      std::cerr << "FAIL: " << message << std::endl;
+      std::cerr << "  Expected: " << expected << ", Got: " << actual << std::endl;
+      assert(false);
+    }
+  }
+}
+
+using namespace TestUtils;
+
+Plugin restock;
+
+// the limiter clips at its ceiling before the output is scaled to volts
+const float MAX_VOLTAGE = 5.f * LIMITER_CEILING;
+
+/*
+ * A module with both outputs patched and numVoices voices on the V/Oct
+ * input, or the input left unpatched for 0
+ */
+ReGrandy* createPatched(int numVoices)
+{
+  ReGrandy* module = dynamic_cast<ReGrandy*>(modelReGrandy->createModule());
+
+  module->outputs[ReGrandy::SINE_OUTPUT].channels = 1;
+  module->outputs[ReGrandy::INV_OUTPUT].channels = 1;
+
+  Input& freq = module->inputs[ReGrandy::FREQ_INPUT];
+  freq.channels = numVoices;
+  for (int c = 0; c < numVoices; c++)
+    freq.voltages[c] = (c - 8) * 0.25f;
+  module->params[ReGrandy::FREQCV_PARAM].setValue(1.f);
+
+  return module;
+}
+
+/*
+ * Runs numSamples samples and returns the largest output voltage,
+ * failing on any sample that is not finite or not mirrored on the
+ * inverted output
+ */
+float run(ReGrandy* module, int numSamples, float sampleRate = 44100.f)
+{
+  Module::ProcessArgs args = {sampleRate, 1.f / sampleRate, 0};
+  float peak = 0.f;
+  bool finite = true, inverted = true;
+
+  for (int t = 0; t < numSamples; t++)
+  {
+    args.frame = t;
+    module->process(args);
+
+    const Output& sine = module->outputs[ReGrandy::SINE_OUTPUT];
+    const Output& inv = module->outputs[ReGrandy::INV_OUTPUT];
+    for (int c = 0; c < sine.channels; c++)
+    {
+      finite &= std::isfinite(sine.voltages[c]);
+      inverted &= inv.voltages[c] == -sine.voltages[c];
+      peak = std::max(peak, std::abs(sine.voltages[c]));
+    }
+  }
+
+  assertTrue(finite, "Every output sample should be finite");
+  assertTrue(inverted, "The inverted output should mirror the main one");
+  return peak;
+}
+
+void testInit()
+{
+  std::cout << "Testing plugin init..." << std::endl;
+
+  init(&restock);
+  assertTrue(pluginInstance == &restock, "init() should keep the plugin");
+  assertEquals(1, restock.models.size(), "init() should add one model");
+  assertTrue(restock.models[0] == modelReGrandy, "The model should be ReGrandy");
+  assertTrue(activeSimdLevel() == detectSimdLevel(), "init() should pick the kernels for this CPU");
+
+  ReGrandy* module = dynamic_cast<ReGrandy*>(modelReGrandy->createModule());
+  assertEquals(ReGrandy::NUM_PARAMS, module->params.size(), "Every param should be configured");
+  assertEquals(ReGrandy::NUM_INPUTS, module->inputs.size(), "Every input should be configured");
+  assertEquals(ReGrandy::NUM_OUTPUTS, module->outputs.size(), "Every output should be configured");
+  delete module;
+
+  std::cout << "  ✓ Init test passed" << std::endl;
+}
+
+void testMonoOutput()
+{
+  std::cout << "Testing mono output..." << std::endl;
+
+  ReGrandy* module = createPatched(0);
+  float peak = run(module, 44100);
+
+  assertEquals(1, module->outputs[ReGrandy::SINE_OUTPUT].channels, "Unpatched V/Oct should give one voice");
+  assertTrue(peak > 0.1f, "The module should make sound");
+  assertTrue(peak <= MAX_VOLTAGE, "The limiter should bound the output");
+  delete module;
+
+  std::cout << "  ✓ Mono output test passed" << std::endl;
+}
+
+void testPolyphonicOutput()
+{
+  std::cout << "Testing polyphonic output..." << std::endl;
+
+  const int counts[] = {1, 3, 4, 5, 16};
+  for (int numVoices : counts)
+  {
+    ReGrandy* module = createPatched(numVoices);
+    run(module, 4410);
+    assertEquals(numVoices, module->outputs[ReGrandy::SINE_OUTPUT].channels, "Outputs should have one channel per voice");
+    delete module;
+  }
+
+  // voices are independent walks, even at the same pitch
+  ReGrandy* module = createPatched(16);
+  for (int c = 0; c < 16; c++)
+    module->inputs[ReGrandy::FREQ_INPUT].voltages[c] = 0.f;
+  run(module, 4410);
+
+  const Output& sine = module->outputs[ReGrandy::SINE_OUTPUT];
+  bool differ = false;
+  for (int c = 1; c < 16; c++)
+    differ |= sine.voltages[c] != sine.voltages[0];
+  assertTrue(differ, "Voices at the same pitch should not be copies");
+  delete module;
+
+  std::cout << "  ✓ Polyphonic output test passed" << std::endl;
+}
+
+void testRenderSettings()
+{
+  std::cout << "Testing control rates and oversampling..." << std::endl;
+
+  for (int controlRate = 0; controlRate < 4; controlRate++)
+    for (int oversampling = 0; oversampling < 5; oversampling++)
+      for (int fm = 0; fm < 2; fm++)
+      {
+        ReGrandy* module = createPatched(4);
+        module->controlRate = controlRate;
+        module->oversampling = oversampling;
+        module->params[ReGrandy::FMTR_PARAM].setValue(fm);
+        module->params[ReGrandy::FREQ_PARAM].setValue(2.f);
+        module->params[ReGrandy::BPTS_PARAM].setValue(30.f);
+
+        float peak = run(module, 4410);
+        assertTrue(peak > 0.f && peak <= MAX_VOLTAGE, "Every render setting should stay bounded");
+        delete module;
+      }
+
+  // audio-rate CV follows the flagged input every sample, the other
+  // controls keep the control rate
+  ReGrandy* module = createPatched(1);
+  module->controlRate = 3;
+  module->audioRateCv[ReGrandy::FREQ_INPUT] = true;
+  module->inputs[ReGrandy::BPTS_INPUT].channels = 1;
+  module->params[ReGrandy::BPTSCV_PARAM].setValue(1.f);
+  module->params[ReGrandy::BPTS_PARAM].setValue(20.f);
+  run(module, 33);
+  assertEquals(32, module->getControlDivision(), "Audio-rate CV should keep the control rate");
+  assertEquals(1 << ReGrandy::FREQ_INPUT, module->getAudioRateInputs(), "Only the flagged input should be read every sample");
+
+  float freq = module->go[0].freq[0];
+  int numBpts = module->go[0].num_bpts[0];
+  module->inputs[ReGrandy::FREQ_INPUT].voltages[0] = 2.f;
+  module->inputs[ReGrandy::BPTS_INPUT].voltages[0] = 5.f;
+  run(module, 1);
+  assertTrue(module->go[0].freq[0] > freq, "An audio-rate input should be read on the next sample");
+  assertEquals(numBpts, module->go[0].num_bpts[0], "Other inputs should wait for the next control period");
+  run(module, 31);
+  assertTrue(module->go[0].num_bpts[0] > numBpts, "Other inputs should be read at the next control period");
+  delete module;
+
+  // every lookahead reports its latency at 44.1 kHz, 0 for the clipper
+  const int latencies[] = {0, 21, 43, 87, 219};
+  module = createPatched(4);
+  module->params[ReGrandy::FREQ_PARAM].setValue(2.f);
+  for (int lookahead = 0; lookahead < 5; lookahead++)
+  {
+    module->lookahead = lookahead;
+    float peak = run(module, 4410);
+    assertEquals(latencies[lookahead], module->getLatency(), "Latency should follow the limiter lookahead");
+    assertTrue(peak <= MAX_VOLTAGE, "Every lookahead should stay bounded");
+  }
+
+  // the decimators add their group delay, rounded to whole samples, and
+  // the menu label follows without reopening the menu
+  const int decimation[] = {0, 13, 15, 16};
+  LatencyLabel label;
+  label.module = module;
+  for (int os = 0; os < 4; os++)
+  {
+    module->oversampling = os;
+    run(module, 64);
+    assertEquals(latencies[4] + decimation[os], module->getLatency(), "Latency should include the decimators");
+    label.step();
+    assertTrue(label.text == "Output latency: " + std::to_string(latencies[4] + decimation[os]) + " samples",
+               "The menu label should show the current latency");
+  }
+  delete module;
+
+  std::cout << "  ✓ Render settings test passed" << std::endl;
+}
+
+void testSampleRateChange()
+{
+  std::cout << "Testing sample rate changes..." << std::endl;
+
+  const float rates[] = {44100.f, 96000.f, 192000.f, 22050.f};
+  ReGrandy* module = createPatched(8);
+
+  for (float sampleRate : rates)
+  {
+    Module::SampleRateChangeEvent e = {sampleRate, 1.f / sampleRate};
+    module->onSampleRateChange(e);
+    float peak = run(module, (int) (sampleRate / 10), sampleRate);
+    assertTrue(peak <= MAX_VOLTAGE, "Output should stay bounded at every rate");
+  }
+
+  delete module;
+
+  std::cout << "  ✓ Sample rate test passed" << std::endl;
+}
+
+void testJsonRoundTrip()
+{
+  std::cout << "Testing dataToJson() and dataFromJson()..." << std::endl;
+
+  ReGrandy* a = createPatched(1);
+  a->controlRate = 1;
+  a->oversampling = 4;
+  a->envCrossfade = false;
+  a->lookahead = 1;
+  a->audioRateCv[ReGrandy::IMOD_INPUT] = true;
+
+  json_t* rootJ = a->dataToJson();
+  ReGrandy* b = createPatched(1);
+  b->dataFromJson(rootJ);
+  json_decref(rootJ);
+
+  assertEquals(1, b->controlRate, "Control rate should be restored");
+  assertEquals(4, b->oversampling, "Oversampling should be restored");
+  assertTrue(!b->envCrossfade, "Envelope crossfade should be restored");
+  assertEquals(1, b->lookahead, "Limiter lookahead should be restored");
+  for (int i = 0; i < ReGrandy::NUM_INPUTS; i++)
+    assertTrue(b->audioRateCv[i] == a->audioRateCv[i], "Audio-rate CV flags should be restored");
+
+  // out-of-range values from a damaged patch are clamped
+  rootJ = json_object();
+  json_object_set_new(rootJ, "controlRate", json_integer(99));
+  json_object_set_new(rootJ, "oversampling", json_integer(-3));
+  json_object_set_new(rootJ, "lookahead", json_integer(12));
+  b->dataFromJson(rootJ);
+  json_decref(rootJ);
+  assertEquals(3, b->controlRate, "Control rate should be clamped");
+  assertEquals(0, b->oversampling, "Oversampling should be clamped");
+  assertEquals(4, b->lookahead, "Limiter lookahead should be clamped");
+
+  delete a;
+  delete b;
+
+  std::cout << "  ✓ JSON round trip test passed" << std::endl;
+}
+
+void testWidget()
+{
+  std::cout << "Testing panel and context menu..." << std::endl;
+
+  ReGrandy* module = createPatched(1);
+  ModuleWidget* widget = modelReGrandy->createModuleWidget(module);
+  assertTrue(widget->module == module, "The panel should be bound to the module");
+
+  Menu menu;
+  widget->appendContextMenu(&menu);
+
+  delete widget;
+  delete module;
+
+  std::cout << "  ✓ Widget test passed" << std::endl;
+}
+
+void testPresets()
+{
+  std::cout << "Testing factory presets and seeds..." << std::endl;
+
+  const std::string dir = "presets/ReGrandy/";
+  DIR* d = opendir(dir.c_str());
+  assertTrue(d != nullptr, "Run from the repository root to find " + dir);
+
+  int numPresets = 0;
+  while (dirent* entry = readdir(d))
+  {
+    std::string name = entry->d_name;
+    if (name.size() < 5 || name.substr(name.size() - 5) != ".vcvm")
+      continue;
+
+    json_error_t error;
+    json_t* rootJ = json_load_file((dir + name).c_str(), 0, &error);
+    assertTrue(rootJ != nullptr, name + " should parse");
+    assertTrue(std::string(json_string_value(json_object_get(rootJ, "model"))) == "ReGrandy", name + " should be a ReGrandy preset");
+
+    // a preset sets every param, the two renders of a seed agree
+    json_t* paramsJ = json_object_get(rootJ, "params");
+    assertEquals(ReGrandy::NUM_PARAMS, json_array_size(paramsJ), name + " should set every param");
+
+    ReGrandy* modules[2] = {createPatched(4), createPatched(4)};
+    for (ReGrandy* module : modules)
+    {
+      for (size_t i = 0; i < json_array_size(paramsJ); i++)
+      {
+        json_t* paramJ = json_array_get(paramsJ, i);
+        int id = json_integer_value(json_object_get(paramJ, "id"));
+        module->params[id].setValue(json_number_value(json_object_get(paramJ, "value")));
+      }
+      module->seed(7);
+      float peak = run(module, 4410);
+      assertTrue(peak <= MAX_VOLTAGE, name + " should stay bounded");
+    }
+
+    for (int c = 0; c < 4; c++)
+      assertTrue(modules[0]->outputs[ReGrandy::SINE_OUTPUT].voltages[c] == modules[1]->outputs[ReGrandy::SINE_OUTPUT].voltages[c],
+                 name + " should render the same for the same seed");
+
+    delete modules[0];
+    delete modules[1];
+    json_decref(rootJ);
+    numPresets++;
+  }
+  closedir(d);
+
+  assertTrue(numPresets >= 15, "Every factory preset should be found");
+
+  std::cout << "  ✓ Preset test passed" << std::endl;
+}
+
+void benchmarkModule()
+{
+  std::cout << "Benchmarking ReGrandy::process()..." << std::endl;
+
+  typedef std::chrono::steady_clock Clock;
+  const int counts[] = {1, 4, 16};
+  const int numSamples = 44100;
+
+  for (int numVoices : counts)
+  {
+    ReGrandy* module = createPatched(numVoices);
+    run(module, 4410);
+
+    Module::ProcessArgs args = {44100.f, 1.f / 44100.f, 0};
+    Clock::time_point start = Clock::now();
+    for (int t = 0; t < numSamples; t++)
+      module->process(args);
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / numSamples;
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "  " << std::setw(2) << numVoices << " voices: " << ns << " ns/sample, "
+              << (1e9 / (ns * 44100.0)) << "x realtime" << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+    delete module;
+  }
+
+  std::cout << "  ✓ Module benchmark done" << std::endl;
+}
+
+// Main test runner
+int main()
+{
+  std::cout << "========================================" << std::endl;
+  std::cout << "Running ReGrandy Module Tests" << std::endl;
+  std::cout << "========================================" << std::endl << std::endl;
+
+  try
+  {
+    testInit();
+    testMonoOutput();
+    testPolyphonicOutput();
+    testRenderSettings();
+    testSampleRateChange();
+    testJsonRoundTrip();
+    testWidget();
+    testPresets();
+    benchmarkModule();
+
+    std::cout << std::endl << "========================================" << std::endl;
+    std::cout << "All tests passed! ✓" << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    return 0;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << std::endl << "Test failed with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,389 @@
+/*
+ * RealtimeSafety_test.cpp
+ * Tests that the audio-thread code never allocates or locks
+ *
+ * Tests cover:
+ * - The harness itself sees allocations and locks
+ * - AudioLimiter::process() at rates up to 768 kHz,
+ *   and lookahead changes
+ * - AudioLimiter::init() and ReGrandy::onSampleRateChange() at rising
+ *   rates up to 768 kHz
+ * - ReGrandy::process() over voices, oversampling, control rates,
+ *   FM, envelope and lookahead changes and audio-rate CV
+ *
+ * malloc, calloc, realloc, free, operator new and delete and the
+ * pthread mutex calls are replaced in this executable. While a Guard
+ * is armed on a thread, every call from that thread is counted and a
+ * test fails on any count above zero. With glibc the replacements
+ * forward to glibc's own entry points and need -ldl before glibc 2.34,
+ * which run_tests.sh adds. Elsewhere only operator new and delete are
+ * seen.
+ */
+
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <mutex>
+#include <algorithm>
+#include <pthread.h>
+
+#include "../plugin.cpp"
+#include "../ReGrandy.cpp"
+#include "../utils/wavetable.cpp"
+
+namespace RealtimeGuard
+{
+  thread_local bool armed = false;
+  thread_local long allocations = 0;
+  thread_local long frees = 0;
+  thread_local long locks = 0;
+
+  /*
+   * Counts the calls made by this thread while it is in scope
+   */
+  struct Guard
+  {
+    Guard()
+    {
+      allocations = frees = locks = 0;
+      armed = true;
+    }
+
+    ~Guard()
+    {
+      armed = false;
+    }
+
+    long total() const
+    {
+      return allocations + frees + locks;
+    }
+  };
+}
+
+#ifdef __GLIBC__
+#include <dlfcn.h>
+
+namespace RealtimeGuard
+{
+  typedef int (*MutexCall)(pthread_mutex_t*);
+
+  MutexCall realLock = nullptr;
+  MutexCall realTrylock = nullptr;
+  MutexCall realUnlock = nullptr;
+
+  // looked up on first use without a static guard, which would lock
+  MutexCall next(MutexCall& call, const char* name)
+  {
+    if (!call)
+      call = (MutexCall) dlsym(RTLD_NEXT, name);
+    return call;
+  }
+}
+
+extern "C"
+{
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t n, size_t size);
+  void* __libc_realloc(void* p, size_t size);
+  void __libc_free(void* p);
+
+  void* malloc(size_t size)
+  {
+    RealtimeGuard::allocations += RealtimeGuard::armed;
+    return __libc_malloc(size);
+  }
+
+  void* calloc(size_t n, size_t size)
+  {
+    RealtimeGuard::allocations += RealtimeGuard::armed;
+    return __libc_calloc(n, size);
+  }
+
+  void* realloc(void* p, size_t size)
+  {
+    RealtimeGuard::allocations += RealtimeGuard::armed;
+    return __libc_realloc(p, size);
+  }
+
+  void free(void* p)
+  {
+    RealtimeGuard::frees += RealtimeGuard::armed && p;
+    __libc_free(p);
+  }
+
+  int pthread_mutex_lock(pthread_mutex_t* m)
+  {
+    RealtimeGuard::locks += RealtimeGuard::armed;
+    return RealtimeGuard::next(RealtimeGuard::realLock, "pthread_mutex_lock")(m);
+  }
+
+  int pthread_mutex_trylock(pthread_mutex_t* m)
+  {
+    RealtimeGuard::locks += RealtimeGuard::armed;
+    return RealtimeGuard::next(RealtimeGuard::realTrylock, "pthread_mutex_trylock")(m);
+  }
+
+  int pthread_mutex_unlock(pthread_mutex_t* m)
+  {
+    return RealtimeGuard::next(RealtimeGuard::realUnlock, "pthread_mutex_unlock")(m);
+  }
+}
+#define ALLOCATIONS_VIA_MALLOC 1
+#else
+#define ALLOCATIONS_VIA_MALLOC 0
+#endif
+
+// with glibc these reach malloc() and free() above
+void* operator new(size_t size)
+{
+  RealtimeGuard::allocations += RealtimeGuard::armed && !ALLOCATIONS_VIA_MALLOC;
+  void* p = std::malloc(size);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+  RealtimeGuard::frees += RealtimeGuard::armed && p && !ALLOCATIONS_VIA_MALLOC;
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  operator delete(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+  operator delete(p);
+}
+
+// Test utilities
+namespace TestUtils
+{
+  void assertTrue(bool condition, const std::string& message)
+  {
+    if (!condition)
+    {
+      std::cerr << "FAIL: " << message << std::endl;
+      assert(false);
+    }
+  }
+
+  /*
+   * Fails with the counts of a guard that saw any call. The message is
+   * a plain string, a std::string would allocate while armed
+   */
+  void assertClean(const RealtimeGuard::Guard& guard, const char* message)
+  {
+    long allocations = RealtimeGuard::allocations, frees = RealtimeGuard::frees, locks = RealtimeGuard::locks;
+    if (guard.total() != 0)
+    {
+      RealtimeGuard::armed = false;
+      std::cerr << "FAIL: " << message << std::endl;
+      std::cerr << "  " << allocations << " allocations, " << frees << " frees, " << locks << " locks" << std::endl;
+      assert(false);
+    }
+  }
+}
+
+using namespace TestUtils;
+
+Plugin restock;
+
+void testHarness()
+{
+  std::cout << "Testing the harness..." << std::endl;
+
+  long allocations, frees, locks;
+  {
+    RealtimeGuard::Guard guard;
+    std::vector<float>* v = new std::vector<float>(100);
+    delete v;
+
+    std::mutex mutex;
+    mutex.lock();
+    mutex.unlock();
+
+    allocations = RealtimeGuard::allocations;
+    frees = RealtimeGuard::frees;
+    locks = RealtimeGuard::locks;
+  }
+
+  assertTrue(allocations == 2, "The harness should count both allocations");
+  assertTrue(frees == 2, "The harness should count both frees");
+#ifdef __GLIBC__
+  assertTrue(locks == 1, "The harness should count the lock");
+#endif
+
+  // a disarmed guard counts nothing
+  delete new int;
+  assertTrue(RealtimeGuard::allocations == 2, "Calls outside a guard should not count");
+
+  std::cout << "  ✓ Harness test passed" << std::endl;
+}
+
+void testLimiterProcess()
+{
+  std::cout << "Testing AudioLimiter::process()..." << std::endl;
+
+  const float rates[] = {44100.f, 96000.f, 192000.f, 768000.f};
+  const int numSamples = 1 << 20;
+  std::vector<float> in(numSamples), out(numSamples);
+  for (int i = 0; i < numSamples; i++)
+    in[i] = 7.f * std::sin(0.05f * i) * std::sin(0.0007f * i);
+
+  long samples = 0;
+  for (float sampleRate : rates)
+  {
+    AudioLimiter limiter;
+    limiter.init(sampleRate);
+
+    RealtimeGuard::Guard guard;
+    limiter.process(in.data(), out.data(), numSamples, 1);
+    for (int i = 0; i < 4096; i++)
+    {
+      limiter.setLookahead((i / 512) % 6);
+      out[i] = limiter.process(in[i]);
+    }
+    assertClean(guard, "AudioLimiter::process() should not allocate or lock");
+    samples += numSamples + 4096;
+  }
+
+  std::cout << "  " << samples << " samples" << std::endl;
+  std::cout << "  ✓ Limiter process test passed" << std::endl;
+}
+
+void testSampleRateChanges()
+{
+  std::cout << "Testing sample rate changes..." << std::endl;
+
+  const float rates[] = {44100.f, 48000.f, 96000.f, 192000.f, 384000.f, 768000.f, 8000.f, 44100.f};
+
+  // constructed at 44.1 kHz, every rise in rate runs inside the guard
+  AudioLimiter limiter;
+  ReGrandy* module = new ReGrandy;
+
+  for (float sampleRate : rates)
+  {
+    RealtimeGuard::Guard guard;
+    limiter.init(sampleRate);
+    Module::SampleRateChangeEvent e = {sampleRate, 1.f / sampleRate};
+    module->onSampleRateChange(e);
+    assertClean(guard, "A sample rate change should not allocate or lock");
+  }
+
+  // rates above the capacity run with a shorter lookahead
+  limiter.init(1536000.f);
+  assertTrue(limiter.getLatency() == LIMITER_MAX_DELAY - 1, "Above 768 kHz the lookahead should be capped");
+  float peak = 0.f;
+  for (int i = 0; i < 100000; i++)
+    peak = std::max(peak, std::abs(limiter.process(7.f * std::sin(0.01f * i))));
+  assertTrue(peak <= LIMITER_CEILING, "Above 768 kHz the limiter should still hold the ceiling");
+
+  delete module;
+
+  std::cout << "  ✓ Sample rate change test passed" << std::endl;
+}
+
+void testModuleProcess()
+{
+  std::cout << "Testing ReGrandy::process()..." << std::endl;
+
+  const int counts[] = {1, 4, 16};
+  long samples = 0;
+
+  for (int numVoices : counts)
+    for (int oversampling = 0; oversampling < 5; oversampling++)
+    {
+      ReGrandy* module = new ReGrandy;
+      module->oversampling = oversampling;
+      module->controlRate = oversampling % 4;
+      module->outputs[ReGrandy::SINE_OUTPUT].channels = 1;
+      module->outputs[ReGrandy::INV_OUTPUT].channels = 1;
+
+      Input& freq = module->inputs[ReGrandy::FREQ_INPUT];
+      freq.channels = numVoices;
+      for (int c = 0; c < numVoices; c++)
+        freq.voltages[c] = (c - 8) * 0.25f;
+      module->params[ReGrandy::FREQCV_PARAM].setValue(1.f);
+      module->params[ReGrandy::BPTS_PARAM].setValue(20.f);
+
+      // audio-rate CV on a patched input half of the time
+      Input& imod = module->inputs[ReGrandy::IMOD_INPUT];
+      imod.channels = 1;
+      module->audioRateCv[ReGrandy::IMOD_INPUT] = oversampling % 2;
+
+      const int numSamples = 96000 / numVoices;
+      Module::ProcessArgs args = {48000.f, 1.f / 48000.f, 0};
+
+      RealtimeGuard::Guard guard;
+      for (int t = 0; t < numSamples; t++)
+      {
+        // the switches and the envelope knob move during the run
+        module->params[ReGrandy::FMTR_PARAM].setValue((t / 3000) % 2);
+        module->params[ReGrandy::MIRR_PARAM].setValue((t / 5000) % 2);
+        module->params[ReGrandy::PDST_PARAM].setValue((t / 7000) % NUM_DISTS);
+        module->params[ReGrandy::ENVS_PARAM].setValue(1 + (t / 2000) % 4);
+        module->lookahead = (t / 4000) % 5;
+        imod.voltages[0] = std::sin(0.01f * t);
+
+        args.frame = t;
+        module->process(args);
+      }
+      assertClean(guard, "ReGrandy::process() should not allocate or lock");
+
+      samples += numSamples * numVoices;
+      delete module;
+    }
+
+  std::cout << "  " << samples << " voice samples" << std::endl;
+  std::cout << "  ✓ Module process test passed" << std::endl;
+}
+
+// Main test runner
+int main()
+{
+  std::cout << "========================================" << std::endl;
+  std::cout << "Running Real-Time Safety Tests" << std::endl;
+  std::cout << "========================================" << std::endl << std::endl;
+
+  try
+  {
+    // builds the shared tables and picks the kernels like Rack does
+    init(&restock);
+
+    testHarness();
+    testLimiterProcess();
+    testSampleRateChanges();
+    testModuleProcess();
+
+    std::cout << std::endl << "========================================" << std::endl;
+    std::cout << "All tests passed! ✓" << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    return 0;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << std::endl << "Test failed with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,403 @@
+/*
+ * Restock_bench.cpp
+ * Speed of the DSP code in src/utils
+ *
+ * Times GendyOscillator::process over breakpoints, FM mode,
+ * distribution, mirroring and sample rate, Wavetable::get and
+ * getPhase4, gRandGen::my_rand per distribution,
+ * GainComputer::process against the dB computer it replaced,
+ * AudioLimiter::process per sample rate, and the whole
+ * ReGrandy::process per sample rate, voice count and oversampling.
+ * Everything is the shipped code compiled against the mock SDK in
+ * mock/. Prints a table and writes the same results as JSON.
+ *
+ * Built and run by `./run_tests.sh --bench` or `make bench`. Options:
+ *   --json <path>   where to write the JSON (default bench.json)
+ *   --quick         time a tenth as many samples
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+
+#include "../plugin.cpp"
+#include "../ReGrandy.cpp"
+#include "../utils/wavetable.cpp"
+
+namespace
+{
+  const int NUM_BPTS[] = {3, 12, 25, 50};
+  const float SAMPLE_RATES[] = {44100.f, 48000.f, 96000.f, 192000.f};
+  const int NUM_VOICES[] = {1, 4, 16};
+  const char *OVERSAMPLING_NAMES[] = {"1x", "2x", "4x", "8x", "auto"};
+  const char *ENV_NAMES[NUM_ENVS] = {"SIN", "TRI", "HANN", "WELCH", "TUKEY"};
+  const char *DIST_NAMES[NUM_DISTS] = {"LINEAR", "CAUCHY", "ARCSINE", "LOGISTIC", "HYPERBCOS", "EXPONENTIAL"};
+
+  // repeats of each measurement, the fastest one is kept
+  const int REPEATS = 3;
+
+  typedef std::chrono::steady_clock Clock;
+
+  struct Result
+  {
+    std::string name;
+    std::string params;   // "key=value" pairs separated by spaces
+    double nsPerSample;
+    float sampleRate;     // 0 when the call does not run per audio sample
+
+    // seconds of audio rendered per second of CPU time
+    double realtimeFactor() const
+    {
+      return sampleRate > 0.f ? 1e9 / (nsPerSample * sampleRate) : 0.0;
+    }
+  };
+
+  std::vector<Result> results;
+  volatile float sink = 0.f;
+
+  /*
+   * Fastest of REPEATS runs of f(n), in ns per iteration
+   */
+  template <typename F>
+  double timeIt(F f, int n)
+  {
+    double best = 1e30;
+    for (int r = 0; r < REPEATS; r++)
+    {
+      Clock::time_point start = Clock::now();
+      f(n);
+      double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / n;
+      best = std::min(best, ns);
+    }
+    return best;
+  }
+
+  void add(const std::string &name, const std::string &params, double ns, float sampleRate)
+  {
+    Result r = {name, params, ns, sampleRate};
+    results.push_back(r);
+  }
+
+  void benchOscillator(double seconds)
+  {
+    for (float sr : SAMPLE_RATES)
+      for (int bpts : NUM_BPTS)
+        for (int fm = 0; fm < 2; fm++)
+          for (int d = 0; d < NUM_DISTS; d++)
+            for (int mirror = 0; mirror < 2; mirror++)
+            {
+              GendyOscillator osc;
+              osc.seed(1);
+              osc.is_fm_on = fm;
+              osc.dt = (DistType) d;
+              osc.is_mirroring = mirror;
+              osc.max_amp_step = 0.2f;
+              osc.max_dur_step = 0.2f;
+              for (int i = 0; i < 4; i++)
+                osc.num_bpts[i] = bpts;
+
+              const float deltaTime = 1.f / sr;
+              double ns = timeIt([&](int n) {
+                for (int t = 0; t < n; t++)
+                  osc.process(deltaTime);
+                sink += osc.out()[0];
+              }, (int) (seconds * sr));
+
+              std::ostringstream params;
+              params << "sample_rate=" << sr << " num_bpts=" << bpts << " fm=" << (fm ? "on" : "off")
+                     << " dist=" << DIST_NAMES[d] << " mirror=" << (mirror ? "on" : "off");
+              add("GendyOscillator::process", params.str(), ns, sr);
+            }
+  }
+
+  void benchWavetable(int n)
+  {
+    for (int e = 0; e < NUM_ENVS; e++)
+    {
+      Wavetable table((EnvType) e);
+
+      double ns = timeIt([&](int n) {
+        float x = 0.f, acc = 0.f;
+        for (int t = 0; t < n; t++)
+        {
+          acc += table.get(x);
+          x += 0.000371f;
+          x -= (x >= 1.f);
+        }
+        sink += acc;
+      }, n);
+      add("Wavetable::get", std::string("env=") + ENV_NAMES[e], ns, 0.f);
+
+      ns = timeIt([&](int n) {
+        uint32_t phase[4] = {0u, 0x40000000u, 0x80000000u, 0xc0000000u};
+        simd::float_4 acc = 0.f;
+        for (int t = 0; t < n; t++)
+        {
+          acc += table.getPhase4(phase);
+          for (int k = 0; k < 4; k++)
+            phase[k] += 6700417u;
+        }
+        sink += acc[0];
+      }, n);
+      add("Wavetable::getPhase4", std::string("env=") + ENV_NAMES[e], ns, 0.f);
+    }
+  }
+
+  void benchRandom(int n)
+  {
+    gRandGen rg;
+    Xoshiro128x4 rng(3);
+
+    // the uniforms come from a table so only my_rand is timed
+    std::vector<float> u(4096);
+    for (size_t i = 0; i < u.size(); i += 4)
+    {
+      simd::float_4 v = rng.uniform4();
+      for (int k = 0; k < 4; k++)
+        u[i + k] = v[k];
+    }
+
+    for (int d = 0; d < NUM_DISTS; d++)
+    {
+      double ns = timeIt([&](int n) {
+        float acc = 0.f;
+        for (int t = 0; t < n; t++)
+          acc += rg.my_rand((DistType) d, u[t & 4095]);
+        sink += acc;
+      }, n);
+      add("gRandGen::my_rand", std::string("dist=") + DIST_NAMES[d], ns, 0.f);
+    }
+  }
+
+  /*
+   * The soft and hard knee in dB with log10() and pow(), as the limiter
+   * computed its gain before GainComputer
+   */
+  float dbGain(float level)
+  {
+    if (level < 1e-6f)
+      return 1.f;
+
+    float levelDb = 20.f * std::log10(level);
+    float thresholdDb = 20.f * std::log10(LIMITER_THRESHOLD);
+    float ceilingDb = 20.f * std::log10(LIMITER_CEILING);
+
+    float softKneeDb;
+    if (levelDb < thresholdDb - LIMITER_KNEE_WIDTH / 2.f)
+      softKneeDb = levelDb;
+    else if (levelDb > thresholdDb + LIMITER_KNEE_WIDTH / 2.f)
+      softKneeDb = thresholdDb;
+    else
+    {
+      float delta = levelDb - (thresholdDb - LIMITER_KNEE_WIDTH / 2.f);
+      softKneeDb = levelDb - delta * delta / (2.f * LIMITER_KNEE_WIDTH);
+    }
+    float hardKneeDb = std::min(levelDb, ceilingDb);
+
+    float reductionDb = std::min(softKneeDb, hardKneeDb) - levelDb;
+    return std::max(std::pow(10.f, reductionDb / 20.f), MIN_GAIN_REDUCTION);
+  }
+
+  void benchGainComputer(int n)
+  {
+    // envelope of a limited signal, through the knee and above it
+    std::vector<float> envelope(4096);
+    for (int i = 0; i < 4096; i++)
+      envelope[i] = 4.f + 2.f * std::abs(std::sin(0.0015f * i));
+
+    GainComputer gainComputer;
+
+    double ns = timeIt([&](int n) {
+      float acc = 0.f;
+      for (int t = 0; t < n; t++)
+        acc += dbGain(envelope[t & 4095]);
+      sink += acc;
+    }, n);
+    add("GainComputer::process", "curve=db", ns, 0.f);
+
+    ns = timeIt([&](int n) {
+      float acc = 0.f;
+      for (int t = 0; t < n; t++)
+        acc += gainComputer.process(envelope[t & 4095]);
+      sink += acc;
+    }, n);
+    add("GainComputer::process", "curve=linear", ns, 0.f);
+  }
+
+  void benchLimiter(double seconds)
+  {
+    for (float sr : SAMPLE_RATES)
+    {
+      const int n = (int) (seconds * sr);
+      std::vector<float> in(n);
+      for (int i = 0; i < n; i++)
+        in[i] = 6.f * std::sin(2.f * M_PI * 440.f * i / sr) * std::sin(2.f * M_PI * 3.f * i / sr);
+
+      AudioLimiter limiter;
+      limiter.init(sr);
+
+      double ns = timeIt([&](int n) {
+        float acc = 0.f;
+        for (int t = 0; t < n; t++)
+          acc += limiter.process(in[t]);
+        sink += acc;
+      }, n);
+
+      std::ostringstream params;
+      params << "sample_rate=" << sr;
+      add("AudioLimiter::process", params.str(), ns, sr);
+    }
+  }
+
+  void benchModule(double seconds)
+  {
+    for (float sr : SAMPLE_RATES)
+      for (int voices : NUM_VOICES)
+        for (int os = 0; os < 5; os++)
+        {
+          APP->engine->sampleRate = sr;
+          ReGrandy module;
+          module.oversampling = os;
+          module.outputs[ReGrandy::SINE_OUTPUT].channels = 1;
+          module.outputs[ReGrandy::INV_OUTPUT].channels = 1;
+          module.inputs[ReGrandy::FREQ_INPUT].channels = voices;
+          module.params[ReGrandy::FREQCV_PARAM].setValue(1.f);
+          for (int c = 0; c < voices; c++)
+            module.inputs[ReGrandy::FREQ_INPUT].voltages[c] = (c - 8) * 0.25f;
+
+          Module::ProcessArgs args = {sr, 1.f / sr, 0};
+          double ns = timeIt([&](int n) {
+            for (int t = 0; t < n; t++)
+              module.process(args);
+            sink += module.outputs[ReGrandy::SINE_OUTPUT].voltages[0];
+          }, (int) (seconds * sr));
+
+          std::ostringstream params;
+          params << "sample_rate=" << sr << " voices=" << voices << " oversampling=" << OVERSAMPLING_NAMES[os];
+          add("ReGrandy::process", params.str(), ns, sr);
+        }
+    APP->engine->sampleRate = 44100.f;
+  }
+
+  void printTable()
+  {
+    std::cout << std::left << std::setw(28) << "benchmark" << std::setw(72) << "parameters"
+              << std::right << std::setw(12) << "ns/sample" << std::setw(12) << "x realtime" << std::endl;
+    std::cout << std::string(124, '-') << std::endl;
+
+    for (const Result &r : results)
+    {
+      std::cout << std::left << std::setw(28) << r.name << std::setw(72) << r.params
+                << std::right << std::fixed << std::setprecision(1) << std::setw(12) << r.nsPerSample;
+      if (r.sampleRate > 0.f)
+        std::cout << std::setw(12) << r.realtimeFactor();
+      else
+        std::cout << std::setw(12) << "-";
+      std::cout << std::endl;
+    }
+  }
+
+  /*
+   * "key=value key=value" as JSON members, numbers unquoted
+   */
+  std::string paramsToJson(const std::string &params)
+  {
+    std::ostringstream out;
+    std::istringstream in(params);
+    std::string pair;
+    bool first = true;
+
+    out << "{";
+    while (in >> pair)
+    {
+      size_t eq = pair.find('=');
+      std::string key = pair.substr(0, eq);
+      std::string value = pair.substr(eq + 1);
+      bool number = value.find_first_not_of("0123456789.") == std::string::npos;
+
+      out << (first ? "" : ", ") << "\"" << key << "\": ";
+      if (number)
+        out << value;
+      else
+        out << "\"" << value << "\"";
+      first = false;
+    }
+    out << "}";
+    return out.str();
+  }
+
+  bool writeJson(const std::string &path)
+  {
+    std::ofstream out(path.c_str());
+    if (!out)
+      return false;
+
+    out << "{\n  \"simd_level\": \"" << simdLevelName(activeSimdLevel()) << "\",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+      const Result &r = results[i];
+      out << "    {\"name\": \"" << r.name << "\", \"params\": " << paramsToJson(r.params)
+          << ", \"ns_per_sample\": " << std::fixed << std::setprecision(3) << r.nsPerSample
+          << ", \"realtime_factor\": ";
+      if (r.sampleRate > 0.f)
+        out << r.realtimeFactor();
+      else
+        out << "null";
+      out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return true;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  std::string jsonPath = "bench.json";
+  bool quick = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!std::strcmp(argv[i], "--json") && i + 1 < argc)
+      jsonPath = argv[++i];
+    else if (!std::strcmp(argv[i], "--quick"))
+      quick = true;
+    else
+    {
+      std::cerr << "usage: " << argv[0] << " [--json <path>] [--quick]" << std::endl;
+      return 1;
+    }
+  }
+
+  // builds the shared tables and picks the kernels like Rack does
+  Plugin restock;
+  init(&restock);
+
+  const double seconds = quick ? 0.05 : 0.5;
+  const int calls = quick ? 200000 : 2000000;
+
+  benchOscillator(seconds);
+  benchWavetable(calls);
+  benchRandom(calls);
+  benchGainComputer(calls);
+  benchLimiter(seconds);
+  benchModule(seconds);
+
+  std::cout << "Kernels: " << simdLevelName(activeSimdLevel()) << std::endl << std::endl;
+  printTable();
+
+  if (!writeJson(jsonPath))
+  {
+    std::cerr << "Could not write " << jsonPath << std::endl;
+    return 1;
+  }
+  std::cout << std::endl << "Results written to " << jsonPath << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * SimdDispatch_test.cpp
+ * Tests for the instruction set variants of the hot loops
+ *
+ * Tests cover:
+ * - CPU detection and level names
+ * - AVX2 table gather against the generic lookup
+ * - Oscillator kernels of every supported level against the generic one
+ * - Oscillator time per sample of each supported level
+ *
+ * Levels the CPU running the test does not support are skipped. Like
+ * the other tests this compiles the real headers against mock/.
+ */
+
+#include <iostream>
+#include <cmath>
+#include <cassert>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+
+#include "../utils/GrandyOscillator.hpp"
+#include "../utils/wavetable.cpp"
+
+using namespace rack;
+
+// Test utilities
+namespace TestUtils
+{
+  void assertTrue(bool condition, const std::string& message)
+  {
+    if (!condition)
+    {
+      std::cerr << "FAIL: " << message << std::endl;
+      assert(false);
+    }
+  }
+
+  void assertLess(float value, float max, const std::string& message)
+  {
+    if (value >= max)
+    {
+      std::cerr << "FAIL: " << message << std::endl;
+      std::cerr << "  Value " << value << " is not less than " << max << std::endl;
+      assert(false);
+    }
+  }
+}
+
+using namespace TestUtils;
+
+const float SAMPLE_TIME = 1.f / 44100.f;
+const float TOLERANCE = 1e-5f;
+
+SimdLevel detected = SIMD_GENERIC;
+
+void testDetection()
+{
+  std::cout << "Testing CPU detection..." << std::endl;
+
+  detected = detectSimdLevel();
+  assertTrue(detected >= SIMD_GENERIC && detected < NUM_SIMD_LEVELS, "Detected level should be valid");
+  assertTrue(activeSimdLevel() == SIMD_GENERIC, "Kernels should stay generic until init() picks a level");
+  assertTrue(std::string(simdLevelName(SIMD_GENERIC)) == "generic", "Generic level name");
+
+  std::cout << "  detected " << simdLevelName(detected) << std::endl;
+  std::cout << "  ✓ Detection test passed" << std::endl;
+}
+
+void testGather()
+{
+  std::cout << "Testing AVX2 table gather..." << std::endl;
+
+#if SIMD_DISPATCH
+  if (detected < SIMD_AVX2)
+  {
+    std::cout << "  - skipped, no AVX2" << std::endl;
+    return;
+  }
+
+  Wavetable table(HANN);
+  Xoshiro128x4 rng(5);
+
+  float worst = 0.f;
+  for (int n = 0; n < 100000; n++)
+  {
+    uint32_t phase[4];
+    for (int k = 0; k < 4; k++)
+      phase[k] = (uint32_t) (rng.uniform4()[k] * 4294967296.0);
+    phase[0] = n < 4 ? 0xffffffffu - n : phase[0];
+
+    simd::float_4 a = table.getPhase4(phase);
+    simd::float_4 b = table.getPhase4Avx2(phase);
+    for (int k = 0; k < 4; k++)
+      worst = std::max(worst, std::abs(a[k] - b[k]));
+  }
+  assertLess(worst, 1e-6f, "Gather should match getPhase4() up to rounding");
+
+  std::cout << "  ✓ Gather test passed" << std::endl;
+#else
+  std::cout << "  - skipped, not x86" << std::endl;
+#endif
+}
+
+/*
+ * Largest difference between the output of level and the generic
+ * kernels over numBlocks blocks
+ */
+float compareOscillator(SimdLevel level, bool fm, bool mirroring, DistType d, int numBlocks)
+{
+  GendyOscillator a, b;
+  a.seed(42);
+  b.seed(42);
+
+  GendyOscillator* both[2] = {&a, &b};
+  for (GendyOscillator* osc : both)
+  {
+    osc->freq = simd::float_4(110.f, 440.f, 1500.f, 4000.f);
+    osc->max_amp_step = 0.2f;
+    osc->max_dur_step = 0.2f;
+    osc->i_mod = 500.f;
+  }
+
+  const GendyOscillator::Kernel& generic = GendyOscillator::getKernel(fm, mirroring, d, SIMD_GENERIC);
+  const GendyOscillator::Kernel& variant = GendyOscillator::getKernel(fm, mirroring, d, level);
+
+  simd::float_4 outA[16], outB[16];
+  float maxDiff = 0.f;
+  for (int n = 0; n < numBlocks; n++)
+  {
+    a.processBlock(outA, 16, SAMPLE_TIME, generic);
+    b.processBlock(outB, 16, SAMPLE_TIME, variant);
+    for (int t = 0; t < 16; t++)
+      for (int i = 0; i < 4; i++)
+        maxDiff = std::max(maxDiff, std::abs(outA[t][i] - outB[t][i]));
+  }
+  return maxDiff;
+}
+
+void testOscillatorVariants()
+{
+  std::cout << "Testing oscillator kernels of every level..." << std::endl;
+
+  for (int level = SIMD_AVX2; level <= detected; level++)
+  {
+    float worst = 0.f;
+    for (int fm = 0; fm < 2; fm++)
+      for (int mirroring = 0; mirroring < 2; mirroring++)
+        for (int d = 0; d < NUM_DISTS; d++)
+          worst = std::max(worst, compareOscillator((SimdLevel) level, fm, mirroring, (DistType) d, 500));
+
+    std::cout << "  " << simdLevelName((SimdLevel) level) << ": max difference " << worst << std::endl;
+    assertLess(worst, TOLERANCE, "Oscillator variants should match the generic kernel");
+  }
+
+  std::cout << "  ✓ Oscillator variant test passed" << std::endl;
+}
+
+void benchmarkLevels()
+{
+  std::cout << "Benchmarking the oscillator per level..." << std::endl;
+
+  typedef std::chrono::steady_clock Clock;
+  const int numBlocks = 20000;
+
+  for (int level = SIMD_GENERIC; level <= detected; level++)
+  {
+    GendyOscillator osc;
+    osc.seed(1);
+
+    const GendyOscillator::Kernel& kernel = GendyOscillator::getKernel(false, false, LINEAR, (SimdLevel) level);
+    simd::float_4 out[16];
+    volatile float sink = 0.f;
+
+    Clock::time_point start = Clock::now();
+    for (int n = 0; n < numBlocks; n++)
+    {
+      osc.processBlock(out, 16, SAMPLE_TIME, kernel);
+      sink += out[15][0];
+    }
+    double oscNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (numBlocks * 16);
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "  " << simdLevelName((SimdLevel) level) << ": oscillator " << oscNs
+              << " ns/sample (4 voices)" << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+  }
+
+  std::cout << "  ✓ Level benchmark done" << std::endl;
+}
+
+// Main test runner
+int main()
+{
+  std::cout << "========================================" << std::endl;
+  std::cout << "Running SIMD Dispatch Tests" << std::endl;
+  std::cout << "========================================" << std::endl << std::endl;
+
+  try
+  {
+    testDetection();
+    testGather();
+    testOscillatorVariants();
+    benchmarkLevels();
+
+    std::cout << std::endl << "========================================" << std::endl;
+    std::cout << "All tests passed! ✓" << std::endl;
+    std::cout << "========================================" << std::endl;
+
+    return 0;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << std::endl << "Test failed with exception: " << e.what() << std::endl;
+    return 1;
+  }
+}
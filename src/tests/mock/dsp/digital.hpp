@@ -0,0 +1,10 @@
+/*
+ * dsp/digital.hpp (test mock)
+ *
+ * Nothing from the SDK's digital helpers is used by the headers under
+ * test, this only satisfies their include.
+ */
+
+#pragma once
+
+#include "rack.hpp"
@@ -0,0 +1,666 @@
+/*
+ * rack.hpp (test mock)
+ *
+ * Just enough of the Rack SDK for the headers in src/utils and the
+ * module sources in src to compile in the standalone tests and
+ * benchmarks. run_tests.sh puts this directory ahead of the SDK, whose
+ * own rack.hpp needs the plugin build flags.
+ *
+ * Module, Port and Param hold plain values, so a test can set params
+ * and input voltages, call process() and read the outputs. Widgets,
+ * menus and the plugin registry are empty shells that only exist so
+ * ReGrandy.hpp and plugin.cpp compile. float_4 is plain scalar code
+ * here, timings taken against it are only good for comparing two
+ * variants with each other.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <random>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#define DEBUG(format, ...) rack::logger::log(format, ##__VA_ARGS__)
+#define INFO(format, ...) rack::logger::log(format, ##__VA_ARGS__)
+#define WARN(format, ...) rack::logger::log(format, ##__VA_ARGS__)
+
+namespace rack {
+
+  // The SDK's logger takes a mutex and writes to a file, this one only
+  // takes the mutex, so logging on the audio thread shows up in the
+  // real-time safety test
+  namespace logger {
+    inline void log(const char *format, ...) {
+      static std::mutex mutex;
+      std::lock_guard<std::mutex> lock(mutex);
+    }
+  }
+
+  static const int PORT_MAX_CHANNELS = 16;
+
+  namespace math {
+    inline float clamp(float x, float a, float b) { return std::fmax(std::fmin(x, b), a); }
+    inline int clamp(int x, int a, int b) { return std::max(std::min(x, b), a); }
+    inline float rescale(float x, float xMin, float xMax, float yMin, float yMax) { return yMin + (x - xMin) / (xMax - xMin) * (yMax - yMin); }
+    inline float crossfade(float a, float b, float p) { return a + (b - a) * p; }
+
+    struct Vec {
+      float x = 0.f, y = 0.f;
+      Vec() {}
+      Vec(float x, float y) : x(x), y(y) {}
+    };
+  }
+  using namespace math;
+
+  namespace simd {
+    template <typename T, int N> struct Vector;
+
+    template <> struct Vector<float, 4> {
+#if defined(__x86_64__) || defined(__i386__)
+      union {
+        __m128 v;
+        float s[4];
+      };
+#else
+      float s[4];
+#endif
+
+      Vector() = default;
+#if defined(__x86_64__) || defined(__i386__)
+      Vector(__m128 v) : v(v) {}
+#endif
+      Vector(float x) { for (int i = 0; i < 4; i++) s[i] = x; }
+      Vector(float a, float b, float c, float d) { s[0] = a; s[1] = b; s[2] = c; s[3] = d; }
+
+      static Vector zero() { return Vector(0.f); }
+      static Vector mask() { Vector r; uint32_t m = 0xffffffff; for (int i = 0; i < 4; i++) std::memcpy(&r.s[i], &m, 4); return r; }
+      static Vector load(const float *x) { Vector r; std::memcpy(r.s, x, 16); return r; }
+      void store(float *x) { std::memcpy(x, s, 16); }
+
+      float &operator[](int i) { return s[i]; }
+      const float &operator[](int i) const { return s[i]; }
+    };
+    typedef Vector<float, 4> float_4;
+
+    #define MOCK_OP(op) \
+    inline float_4 operator op(const float_4 &a, const float_4 &b) { float_4 r; for (int i = 0; i < 4; i++) r.s[i] = a.s[i] op b.s[i]; return r; } \
+    inline float_4 &operator op##=(float_4 &a, const float_4 &b) { a = a op b; return a; }
+    MOCK_OP(+) MOCK_OP(-) MOCK_OP(*) MOCK_OP(/)
+    #undef MOCK_OP
+
+    inline float_4 operator-(const float_4 &a) { return float_4(0.f) - a; }
+
+    #define MOCK_BIT(op) \
+    inline float_4 operator op(const float_4 &a, const float_4 &b) { float_4 r; for (int i = 0; i < 4; i++) { uint32_t x, y; std::memcpy(&x, &a.s[i], 4); std::memcpy(&y, &b.s[i], 4); x = x op y; std::memcpy(&r.s[i], &x, 4); } return r; } \
+    inline float_4 &operator op##=(float_4 &a, const float_4 &b) { a = a op b; return a; }
+    MOCK_BIT(&) MOCK_BIT(|) MOCK_BIT(^)
+    #undef MOCK_BIT
+
+    // comparisons give all-ones lanes where true, like the SSE versions
+    #define MOCK_CMP(op) \
+    inline float_4 operator op(const float_4 &a, const float_4 &b) { float_4 r; for (int i = 0; i < 4; i++) { uint32_t m = (a.s[i] op b.s[i]) ? 0xffffffff : 0; std::memcpy(&r.s[i], &m, 4); } return r; }
+    MOCK_CMP(==) MOCK_CMP(!=) MOCK_CMP(<) MOCK_CMP(<=) MOCK_CMP(>) MOCK_CMP(>=)
+    #undef MOCK_CMP
+
+    #define MOCK_FN(name, fn) \
+    inline float_4 name(float_4 a) { float_4 r; for (int i = 0; i < 4; i++) r.s[i] = fn(a.s[i]); return r; }
+    MOCK_FN(sin, std::sin) MOCK_FN(cos, std::cos) MOCK_FN(floor, std::floor) MOCK_FN(trunc, std::trunc)
+    MOCK_FN(fabs, std::fabs) MOCK_FN(exp, std::exp) MOCK_FN(log, std::log) MOCK_FN(sqrt, std::sqrt)
+    #undef MOCK_FN
+
+    inline float_4 fmin(float_4 a, float_4 b) { float_4 r; for (int i = 0; i < 4; i++) r.s[i] = std::fmin(a.s[i], b.s[i]); return r; }
+    inline float_4 fmax(float_4 a, float_4 b) { float_4 r; for (int i = 0; i < 4; i++) r.s[i] = std::fmax(a.s[i], b.s[i]); return r; }
+    inline float_4 clamp(float_4 x, float_4 a = 0.f, float_4 b = 1.f) { return fmin(fmax(x, a), b); }
+    inline float_4 ifelse(float_4 mask, float_4 a, float_4 b) { return (mask & a) | ((float_4::mask() ^ mask) & b); }
+    inline float_4 crossfade(float_4 a, float_4 b, float_4 p) { return a + (b - a) * p; }
+
+    inline int movemask(float_4 a) {
+      int m = 0;
+      for (int i = 0; i < 4; i++) {
+        uint32_t x;
+        std::memcpy(&x, &a.s[i], 4);
+        m |= (x >> 31) << i;
+      }
+      return m;
+    }
+  }
+
+  // deterministic stand-in for Rack's global generator
+  namespace random {
+    // one generator per thread, like the SDK's
+    inline std::mt19937 &gen() { static thread_local std::mt19937 g(1); return g; }
+    inline uint32_t u32() { return gen()(); }
+    inline uint64_t u64() { return ((uint64_t) u32() << 32) | u32(); }
+    inline float uniform() { return (u32() >> 8) * (1.f / 16777216.f); }
+    inline float normal() { std::normal_distribution<float> d; return d(gen()); }
+  }
+
+  namespace dsp {
+    static const float FREQ_C4 = 261.6256f;
+
+    inline float quadraticBipolar(float x) { float x2 = x * x; return (x >= 0.f) ? x2 : -x2; }
+
+    // exact here, the SDK's polynomial is within 1e-5 of it
+    template <typename T> T exp2_taylor5(T x);
+    template <> inline float exp2_taylor5(float x) { return std::exp2(x); }
+    template <> inline simd::float_4 exp2_taylor5(simd::float_4 x) { simd::float_4 r; for (int i = 0; i < 4; i++) r.s[i] = std::exp2(x.s[i]); return r; }
+
+    struct SchmittTrigger {
+      bool state = true;
+      bool process(float in) {
+        if (state) {
+          if (in <= 0.f)
+            state = false;
+          return false;
+        }
+        if (in >= 1.f) {
+          state = true;
+          return true;
+        }
+        return false;
+      }
+    };
+
+    struct ClockDivider {
+      uint32_t clock = 0;
+      uint32_t division = 1;
+
+      void reset() { clock = 0; }
+      void setDivision(uint32_t d) { division = d; }
+      uint32_t getDivision() { return division; }
+      uint32_t getClock() { return clock; }
+      bool process() {
+        clock++;
+        if (clock >= division) {
+          clock = 0;
+          return true;
+        }
+        return false;
+      }
+    };
+  }
+
+  struct Param {
+    float value = 0.f;
+    float getValue() { return value; }
+    void setValue(float v) { value = v; }
+  };
+
+  /*
+   * A cable is patched by setting channels, 0 means unpatched
+   */
+  struct Port {
+    float voltages[PORT_MAX_CHANNELS] = {};
+    uint8_t channels = 0;
+
+    float getVoltage(int c = 0) { return voltages[c]; }
+    float getPolyVoltage(int c) { return channels == 1 ? voltages[0] : voltages[c]; }
+    template <typename T> T getVoltageSimd(int c) { return T::load(&voltages[c]); }
+    template <typename T> T getPolyVoltageSimd(int c) { return channels == 1 ? T(voltages[0]) : getVoltageSimd<T>(c); }
+    void setVoltage(float v, int c = 0) { voltages[c] = v; }
+    template <typename T> void setVoltageSimd(T v, int c) { v.store(&voltages[c]); }
+
+    // like the SDK, outputs with no cable keep zero channels
+    void setChannels(int n) {
+      if (channels == 0)
+        return;
+      for (int c = n; c < channels; c++)
+        voltages[c] = 0.f;
+      if (n == 0)
+        voltages[0] = 0.f;
+      channels = n;
+    }
+
+    int getChannels() { return channels; }
+    bool isConnected() { return channels > 0; }
+    bool isMonophonic() { return channels == 1; }
+    bool isPolyphonic() { return channels > 1; }
+  };
+
+  struct Input : Port {};
+  struct Output : Port {};
+
+  struct Light {
+    float value = 0.f;
+    void setBrightness(float b) { value = b; }
+  };
+
+  struct ParamQuantity {
+    std::string name;
+  };
+
+  /*
+   * Tree of values with the subset of the jansson API the modules and
+   * the offline renderer use. Values are reference counted as in
+   * jansson, json_decref() frees a value and its children once the
+   * last reference is dropped.
+   */
+  struct json_t {
+    enum Type { OBJECT, ARRAY, STRING, INTEGER, REAL, TRUE_, FALSE_, NULL_ } type;
+    int refcount = 1;
+    long long integer = 0;
+    double real = 0.0;
+    std::string string;
+    std::vector<std::pair<std::string, json_t *> > object;
+    std::vector<json_t *> array;
+  };
+
+  inline json_t *json_new(json_t::Type type) { json_t *j = new json_t; j->type = type; return j; }
+  inline json_t *json_object() { return json_new(json_t::OBJECT); }
+  inline json_t *json_array() { return json_new(json_t::ARRAY); }
+  inline json_t *json_integer(long long v) { json_t *j = json_new(json_t::INTEGER); j->integer = v; return j; }
+  inline json_t *json_real(double v) { json_t *j = json_new(json_t::REAL); j->real = v; return j; }
+  inline json_t *json_boolean(bool v) { return json_new(v ? json_t::TRUE_ : json_t::FALSE_); }
+  inline json_t *json_string(const char *v) { json_t *j = json_new(json_t::STRING); j->string = v; return j; }
+  inline json_t *json_null() { return json_new(json_t::NULL_); }
+
+  inline void json_decref(json_t *j);
+
+  inline json_t *json_incref(json_t *j) {
+    if (j)
+      j->refcount++;
+    return j;
+  }
+
+  inline int json_object_set_new(json_t *o, const char *k, json_t *v) {
+    for (auto &p : o->object) {
+      if (p.first == k) {
+        json_decref(p.second);
+        p.second = v;
+        return 0;
+      }
+    }
+    o->object.push_back(std::make_pair(std::string(k), v));
+    return 0;
+  }
+
+  inline json_t *json_object_get(json_t *o, const char *k) {
+    if (!o)
+      return nullptr;
+    for (auto &p : o->object)
+      if (p.first == k)
+        return p.second;
+    return nullptr;
+  }
+
+  inline int json_array_append_new(json_t *a, json_t *v) { a->array.push_back(v); return 0; }
+  inline json_t *json_array_get(json_t *a, size_t i) { return (a && i < a->array.size()) ? a->array[i] : nullptr; }
+  inline size_t json_array_size(json_t *a) { return a ? a->array.size() : 0; }
+  inline long long json_integer_value(json_t *j) { return j && j->type == json_t::INTEGER ? j->integer : 0; }
+  inline double json_real_value(json_t *j) { return j && j->type == json_t::REAL ? j->real : 0.0; }
+  inline double json_number_value(json_t *j) { return !j ? 0.0 : j->type == json_t::INTEGER ? j->integer : j->type == json_t::REAL ? j->real : 0.0; }
+  inline bool json_is_true(json_t *j) { return j && j->type == json_t::TRUE_; }
+  inline bool json_boolean_value(json_t *j) { return json_is_true(j); }
+  inline const char *json_string_value(json_t *j) { return j && j->type == json_t::STRING ? j->string.c_str() : nullptr; }
+  inline bool json_is_object(json_t *j) { return j && j->type == json_t::OBJECT; }
+  inline bool json_is_array(json_t *j) { return j && j->type == json_t::ARRAY; }
+
+  inline void json_decref(json_t *j) {
+    if (!j || --j->refcount > 0)
+      return;
+    for (auto &p : j->object)
+      json_decref(p.second);
+    for (json_t *a : j->array)
+      json_decref(a);
+    delete j;
+  }
+
+  struct json_error_t {
+    int line;
+    char text[160];
+  };
+
+  /*
+   * Recursive descent parser for json_loads() and json_load_file().
+   * Strings keep their escapes except \" and \\, which is enough for
+   * Rack patches and presets.
+   */
+  struct JsonParser {
+    const char *p;
+    int line = 1;
+    const char *error = nullptr;
+
+    void skip() {
+      for (; *p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'; p++)
+        line += *p == '\n';
+    }
+
+    bool literal(const char *word) {
+      size_t n = std::strlen(word);
+      if (std::strncmp(p, word, n))
+        return false;
+      p += n;
+      return true;
+    }
+
+    bool parseString(std::string &out) {
+      for (p++; *p && *p != '"'; p++) {
+        if (*p == '\\' && (p[1] == '"' || p[1] == '\\'))
+          p++;
+        else if (*p == '\\' && p[1])
+          out += *p++;
+        out += *p;
+      }
+      if (*p != '"')
+        return false;
+      p++;
+      return true;
+    }
+
+    json_t *parseValue() {
+      skip();
+      if (*p == '{') {
+        json_t *o = json_object();
+        p++;
+        skip();
+        if (*p == '}') {
+          p++;
+          return o;
+        }
+        while (*p == '"') {
+          std::string key;
+          if (!parseString(key))
+            break;
+          skip();
+          if (*p != ':')
+            break;
+          p++;
+          json_t *v = parseValue();
+          if (!v)
+            break;
+          json_object_set_new(o, key.c_str(), v);
+          skip();
+          if (*p == '}') {
+            p++;
+            return o;
+          }
+          if (*p != ',')
+            break;
+          p++;
+          skip();
+        }
+        json_decref(o);
+      }
+      else if (*p == '[') {
+        json_t *a = json_array();
+        p++;
+        skip();
+        if (*p == ']') {
+          p++;
+          return a;
+        }
+        while (json_t *v = parseValue()) {
+          json_array_append_new(a, v);
+          skip();
+          if (*p == ']') {
+            p++;
+            return a;
+          }
+          if (*p != ',')
+            break;
+          p++;
+        }
+        json_decref(a);
+      }
+      else if (*p == '"') {
+        std::string s;
+        if (parseString(s))
+          return json_string(s.c_str());
+      }
+      else if (*p == '-' || (*p >= '0' && *p <= '9')) {
+        char *end;
+        const char *start = p;
+        double real = std::strtod(start, &end);
+        long long integer = std::strtoll(start, nullptr, 10);
+        p = end;
+        if (std::strcspn(start, ".eE") < (size_t) (end - start))
+          return json_real(real);
+        return json_integer(integer);
+      }
+      else if (literal("true"))
+        return json_boolean(true);
+      else if (literal("false"))
+        return json_boolean(false);
+      else if (literal("null"))
+        return json_null();
+
+      if (!error)
+        error = "invalid JSON";
+      return nullptr;
+    }
+  };
+
+  inline json_t *json_loads(const char *input, size_t flags, json_error_t *error) {
+    JsonParser parser;
+    parser.p = input;
+    json_t *root = parser.parseValue();
+    parser.skip();
+    if (root && *parser.p) {
+      json_decref(root);
+      root = nullptr;
+      parser.error = "end of file expected";
+    }
+    if (!root && error) {
+      error->line = parser.line;
+      std::snprintf(error->text, sizeof(error->text), "%s", parser.error);
+    }
+    return root;
+  }
+
+  inline json_t *json_load_file(const char *path, size_t flags, json_error_t *error) {
+    FILE *file = std::fopen(path, "rb");
+    if (!file) {
+      if (error) {
+        error->line = 0;
+        std::snprintf(error->text, sizeof(error->text), "unable to open %s", path);
+      }
+      return nullptr;
+    }
+    std::string text;
+    char chunk[4096];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+      text.append(chunk, n);
+    std::fclose(file);
+    return json_loads(text.c_str(), flags, error);
+  }
+
+  namespace engine {
+    struct Module {
+      std::vector<Param> params;
+      std::vector<Input> inputs;
+      std::vector<Output> outputs;
+      std::vector<Light> lights;
+
+      struct ProcessArgs {
+        float sampleRate;
+        float sampleTime;
+        int64_t frame;
+      };
+
+      struct SampleRateChangeEvent {
+        float sampleRate;
+        float sampleTime;
+      };
+
+      virtual ~Module() {}
+
+      void config(int numParams, int numInputs, int numOutputs, int numLights) {
+        params.resize(numParams);
+        inputs.resize(numInputs);
+        outputs.resize(numOutputs);
+        lights.resize(numLights);
+      }
+
+      ParamQuantity *configParam(int id, float min, float max, float def, std::string name = "", std::string unit = "", float = 0.f, float = 1.f, float = 0.f) {
+        params[id].value = def;
+        return nullptr;
+      }
+
+      ParamQuantity *configSwitch(int id, float min, float max, float def, std::string name = "", std::vector<std::string> labels = {}) {
+        params[id].value = def;
+        return nullptr;
+      }
+
+      void configInput(int, std::string = "") {}
+      void configOutput(int, std::string = "") {}
+
+      virtual void process(const ProcessArgs &args) {}
+      virtual void onSampleRateChange() {}
+      virtual void onSampleRateChange(const SampleRateChangeEvent &e) { onSampleRateChange(); }
+      virtual json_t *dataToJson() { return nullptr; }
+      virtual void dataFromJson(json_t *rootJ) {}
+    };
+
+    /*
+     * Modules read sampleRate when they are constructed, a test changes
+     * it later by calling the module's onSampleRateChange() with the
+     * new rate
+     */
+    struct Engine {
+      float sampleRate = 44100.f;
+      float getSampleRate() { return sampleRate; }
+    };
+  }
+  using namespace engine;
+
+  namespace widget {
+    struct Widget {
+      struct {
+        math::Vec pos, size;
+      } box;
+
+      virtual ~Widget() {}
+      virtual void step() {}
+      void addChild(Widget *w) { delete w; }
+    };
+  }
+  using namespace widget;
+
+  namespace ui {
+    struct Menu : Widget {};
+    struct MenuSeparator : Widget {};
+
+    struct MenuItem : Widget {
+      std::string text, rightText;
+    };
+
+    struct MenuLabel : Widget {
+      std::string text;
+    };
+  }
+  using namespace ui;
+
+  inline MenuLabel *createMenuLabel(std::string) { return new MenuLabel; }
+  template <typename T> MenuItem *createIndexPtrSubmenuItem(std::string, std::vector<std::string>, T *) { return new MenuItem; }
+  template <typename T> MenuItem *createBoolPtrMenuItem(std::string, std::string, T *) { return new MenuItem; }
+  inline MenuItem *createBoolMenuItem(std::string, std::string, std::function<bool()>, std::function<void(bool)>) { return new MenuItem; }
+  inline MenuItem *createIndexSubmenuItem(std::string, std::vector<std::string>, std::function<size_t()>, std::function<void(size_t)>) { return new MenuItem; }
+
+  // builds the submenu right away so its lambda runs in the tests
+  inline MenuItem *createSubmenuItem(std::string, std::string, std::function<void(Menu *)> f, bool = false) {
+    Menu m;
+    f(&m);
+    return new MenuItem;
+  }
+
+  struct Svg {};
+
+  namespace window {
+    struct Window {
+      Svg *loadSvg(std::string) { return nullptr; }
+    };
+  }
+
+  struct Context {
+    engine::Engine *engine;
+    window::Window *window;
+  };
+
+  inline Context *contextGet() {
+    static engine::Engine e;
+    static window::Window w;
+    static Context c = {&e, &w};
+    return &c;
+  }
+
+  namespace app {
+    struct ModuleWidget : Widget {
+      Module *module = nullptr;
+
+      void setModule(Module *m) { module = m; }
+      template <class T> T *getModule() { return dynamic_cast<T *>(module); }
+      void setPanel(Svg *) {}
+      virtual void appendContextMenu(Menu *menu) {}
+      void addParam(Widget *w) { delete w; }
+      void addInput(Widget *w) { delete w; }
+      void addOutput(Widget *w) { delete w; }
+    };
+
+    struct SvgPort : Widget {};
+    struct PJ301MPort : SvgPort {};
+    struct Knob : Widget {};
+    struct RoundLargeBlackKnob : Knob {};
+    struct RoundSmallBlackKnob : Knob {};
+    struct RoundBlackSnapKnob : Knob {};
+    struct Trimpot : Knob {};
+    struct CKSS : Widget {};
+    struct CKSSThree : Widget {};
+    struct ScrewSilver : Widget {};
+  }
+  using namespace app;
+
+  static const float RACK_GRID_WIDTH = 15.f;
+  static const float RACK_GRID_HEIGHT = 380.f;
+
+  template <class T> T *createWidget(math::Vec) { return new T; }
+  template <class T> T *createParam(math::Vec, Module *, int) { return new T; }
+  template <class T> T *createInput(math::Vec, Module *, int) { return new T; }
+  template <class T> T *createOutput(math::Vec, Module *, int) { return new T; }
+
+  namespace plugin {
+    struct Model {
+      std::string slug;
+      virtual ~Model() {}
+      virtual engine::Module *createModule() = 0;
+      virtual app::ModuleWidget *createModuleWidget(engine::Module *m) = 0;
+    };
+
+    struct Plugin {
+      std::vector<Model *> models;
+      void addModel(Model *m) { models.push_back(m); }
+    };
+  }
+  using namespace plugin;
+
+  template <class TModule, class TModuleWidget>
+  Model *createModel(std::string slug) {
+    struct TModel : Model {
+      engine::Module *createModule() override { return new TModule; }
+      app::ModuleWidget *createModuleWidget(engine::Module *m) override { return new TModuleWidget(dynamic_cast<TModule *>(m)); }
+    };
+
+    TModel *m = new TModel;
+    m->slug = slug;
+    return m;
+  }
+
+  namespace asset {
+    inline std::string plugin(Plugin *, std::string path) { return path; }
+  }
+
+}
+
+#define APP rack::contextGet()
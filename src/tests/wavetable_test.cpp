@@ -5,215 +5,24 @@
  * Tests cover:
  * - wrap() and mirror() utility functions
  * - gRandGen random generation with different distributions
+ * - Distribution lookup tables against the closed-form inverse transforms
  * - Wavetable initialization and indexing
  * - All envelope types (SIN, TRI, HANN, WELCH, TUKEY)
+ * - Guard point, wrap-around and accuracy of the fast lookups
+ *   (get, get4, getPhase, getPhase4)
  */
 
-// Define test environment before including wavetable.hpp
-#define RACK_HPP_INCLUDED
-#define TABLE_SIZE 2048
-#define M_PI 3.14159265358979323846
-
+// The real wavetable code, compiled against the mock SDK in mock/
 #include <iostream>
 #include <cmath>
 #include <cassert>
 #include <vector>
 #include <string>
 #include <cstdlib>
+#include <cstdint>
+#include <algorithm>
 
-// Minimal Rack SDK mock for testing
-namespace rack {
-    namespace random {
-        static inline float uniform() { return (float)rand() / RAND_MAX; }
-        static inline float normal() { return uniform() * 2.0f - 1.0f; }
-    }
-    namespace logger {
-        enum Level { DEBUG_LEVEL, INFO_LEVEL, WARN_LEVEL, FATAL_LEVEL };
-        static inline void log(Level level, const char* filename, int line, const char* func, const char* format, ...) {}
-    }
-}
-
-#define DEBUG(format, ...) do {} while(0)
-
-// Now include the wavetable utilities
-namespace rack {
-  float wrap(float in, float lb, float ub) {
-    float out = in;
-    if (in > ub) out = lb;
-    else if (in < lb) out = ub;
-    return out;
-  }
-
-  float mirror(float in, float lb, float ub) {
-    float out = in;
-    if (in > ub) {
-      out = ub - (in - ub);
-    }
-    else if (in < lb) {
-      out = lb + (lb - in);
-    }
-    return out;
-  }
-
-  enum DistType {
-    LINEAR,
-    CAUCHY,
-    ARCSINE
-  };
-
-  struct gRandGen {
-    float my_rand(DistType t, float rand) {
-      float c, temp, out;
-      float a = 0.5f;
-      
-      switch (t) {
-        case LINEAR:
-          return rand; 
-        case CAUCHY:
-          c = atan(10 * a);
-          temp = (1.f/a) * tan(c * (2.f * rand - 1.f));
-          out = temp*0.1f;
-          return out;
-        case ARCSINE:
-          c = sinf(1.5707963f * a); 
-		      out = sinf(M_PI * (rand - 0.5f) * a) / c;
-          return out;
-        default:
-          break;
-      }
-      return rand;
-    }
-  };
-   
-  enum EnvType {
-    SIN,
-    TRI,
-    HANN,
-    WELCH,
-    TUKEY,
-    NUM_ENVS
-  };
-
-  struct Wavetable {
-    float table[TABLE_SIZE];
-    EnvType et;
-
-    Wavetable() {
-      et = SIN;
-      initSinWav(); 
-    }
-
-    Wavetable(EnvType e) {
-      et = e;
-      init(e);
-    }
-
-    void init(EnvType e) {
-      switch (e) {
-        case SIN:
-          initSinWav();
-          break;
-        case TRI:
-          initTriEnv();
-          break;
-        case HANN:
-          initHannEnv();
-          break;
-        case WELCH:
-          initWelchEnv();
-          break;
-        case TUKEY:
-          initTukeyEnv();
-          break;
-        default:
-          initSinWav();
-      }
-    }
-
-    void switchEnvType(EnvType e) {
-      if (et != e) {
-        et = e;
-        init(e); 
-      }
-    }
-
-    void initSinWav() {
-      float phase = 0.f;
-      for (int i=0; i<TABLE_SIZE; i++) {
-        table[i] = sinf(2.f*M_PI * phase); 
-        phase += (float) i  / (2.f*M_PI);
-      }
-    }
-
-    void initTriEnv() {
-      float phase = 0.f;
-      for (int i=0; i<TABLE_SIZE; i++) {
-        if (phase < 0.5f) {
-          table[i] = ((2.f * i) / TABLE_SIZE);
-        }
-        else  {
-          table[i] = ((-2.f * i) / TABLE_SIZE) + 2.f;
-        }
-        phase += 1.f / TABLE_SIZE;
-      }
-    }
-
-    void initHannEnv() {
-      float a_0 = 0.5f;
-      for (int i=0; i<TABLE_SIZE; i++) {
-        table[i] = a_0 * (1 - cosf((2.f * M_PI * ((float) i / TABLE_SIZE)) / 1.f));
-      }
-    }
-
-    void initWelchEnv() {
-      float ts = (float) TABLE_SIZE;
-      for (int i=0; i<TABLE_SIZE; i++) {
-        table[i] = 1.f - pow(((float) i - (ts / 2.f)) / (ts / 2.f), 2); 
-      }
-    }
-
-    void initTukeyEnv() {
-      float p1,p2,N,alpha;
-      alpha = 0.5f;
-      N = (float) TABLE_SIZE;
-      p1 = alpha * N / 2;
-      p2 = N * (1 - (alpha / 2));
-
-      for (int i=0; i<TABLE_SIZE; i++) {
-        if (i < p1) {
-          table[i] = 0.5f * (1 + cosf(M_PI * (((2 * i) / (alpha * N)) - 1)));
-        }
-        else if (i <= p2) { 
-          table[i] = 1.f; 
-        } 
-        else {
-          table[i] = 0.5f * (1 + cosf(M_PI * (((2 * i) / (alpha * N)) - (2 / alpha) + 1)));
-        }
-      }
-    }
-
-    float operator[](int x) {
-      return table[x];
-    }
-
-    float operator[](float x) {
-      return index(x); 
-    }
-
-    float index(float x) {
-      float fl = floorf(x);
-      float ph = x - fl;
-      float lb = table[(int) fl];
-      float ub = table[(int) ceilf(x)];
-      return ((1.0 - ph) * lb) + (ph * ub);
-    }
-
-    float get(float x) {
-      if (x > 1.000000) DEBUG("BAD!\n");
-      return index(x * (float) TABLE_SIZE); 
-    }
-  };
-}
+#include "../utils/wavetable.cpp"
 
 using namespace rack;
 
@@ -327,9 +136,9 @@ bool test_mirror_large_overshoot() {
 
 bool test_gRandGen_linear() {
     gRandGen gen;
-    float input = 0.5f;
-    float result = gen.my_rand(LINEAR, input);
-    TEST_ASSERT(float_equal(result, input), "LINEAR distribution should return input unchanged");
+    float result = gen.my_rand(LINEAR, 0.5f);
+    TEST_ASSERT(float_equal(result, 0.0f), "LINEAR distribution should map the middle of [0, 1] to 0");
+    TEST_ASSERT(float_equal(gen.my_rand(LINEAR, 0.75f), 0.5f), "LINEAR distribution should map [0, 1] onto [-1, 1]");
     return true;
 }
 
@@ -354,7 +163,7 @@ bool test_gRandGen_boundary_values() {
     gRandGen gen;
     
     float result1 = gen.my_rand(LINEAR, 0.0f);
-    TEST_ASSERT(float_equal(result1, 0.0f), "LINEAR should handle 0.0 input");
+    TEST_ASSERT(float_equal(result1, -1.0f), "LINEAR should handle 0.0 input");
     
     float result2 = gen.my_rand(LINEAR, 1.0f);
     TEST_ASSERT(float_equal(result2, 1.0f), "LINEAR should handle 1.0 input");
@@ -368,6 +177,123 @@ bool test_gRandGen_boundary_values() {
     return true;
 }
 
+// ============================================================================
+// Distribution table tests
+// ============================================================================
+
+// Largest difference between the table lookup and the closed form over [0, 1]
+double dist_table_error(DistType t, double* range) {
+    gRandGen gen;
+    double max_err = 0.0;
+    double lo = 1e30, hi = -1e30;
+    for (int n = 0; n <= 100000; n++) {
+        float r = n / 100000.0f;
+        double exact = DISTRIBUTIONS[t].inverse(r);
+        max_err = std::max(max_err, std::fabs(gen.my_rand(t, r) - exact));
+        lo = std::min(lo, exact);
+        hi = std::max(hi, exact);
+    }
+    *range = hi - lo;
+    return max_err;
+}
+
+bool test_dist_table_matches_closed_form() {
+    for (int d = 0; d < NUM_DISTS; d++) {
+        double range;
+        double err = dist_table_error((DistType) d, &range);
+        // the logistic and hyperbolic cosine transforms are steep at the
+        // ends of [0, 1], elsewhere the table is much closer than this
+        TEST_ASSERT(err <= 1e-3 * range, std::string("Table lookup should match the closed form for ") + DISTRIBUTIONS[d].name);
+    }
+
+    double range;
+    TEST_ASSERT(dist_table_error(CAUCHY, &range) < 1e-5, "CAUCHY table should be accurate to 1e-5");
+    TEST_ASSERT(dist_table_error(ARCSINE, &range) < 1e-6, "ARCSINE table should be accurate to 1e-6");
+    return true;
+}
+
+bool test_dist_constants_match_formulas() {
+    double a = dist::A;
+    double c = 0.5 + 0.499 * a;
+    TEST_ASSERT(float_equal(dist::CAUCHY_C, (float) std::atan(10.0 * a), 1e-6f), "CAUCHY_C should be atan(10 a)");
+    TEST_ASSERT(float_equal(dist::ARCSINE_C, (float) std::sin(1.5707963 * a), 1e-6f), "ARCSINE_C should be sin(pi/2 a)");
+    TEST_ASSERT(float_equal(dist::LOGISTIC_C, (float) std::log((1.0 - c) / c), 1e-6f), "LOGISTIC_C should match its formula");
+    TEST_ASSERT(float_equal(dist::HYPERBCOS_C, (float) std::tan(1.5692255 * a), 1e-6f), "HYPERBCOS_C should be tan(1.5692255 a)");
+    TEST_ASSERT(float_equal(dist::EXPONENTIAL_C, (float) std::log(1.0 - 0.999 * a), 1e-6f), "EXPONENTIAL_C should be log(1 - 0.999 a)");
+    return true;
+}
+
+bool test_dist_closed_forms_match_original() {
+    // the transforms as gRandGen computed them before the tables, CAUCHY
+    // has poles at about -0.07 and 1.07 so the range stays inside them
+    double max_cauchy = 0.0, max_arcsine = 0.0;
+    for (int n = -50; n <= 1050; n++) {
+        float r = n / 1000.0f;
+        float a = 0.5f;
+        float cauchy = (1.f / a) * tan(atan(10 * a) * (2.f * r - 1.f)) * 0.1f;
+        float arcsine = sinf(M_PI * (r - 0.5f) * a) / sinf(1.5707963f * a);
+        max_cauchy = std::max(max_cauchy, (double) std::fabs(dist::cauchy(r) - cauchy));
+        max_arcsine = std::max(max_arcsine, (double) std::fabs(dist::arcsine(r) - arcsine));
+    }
+    TEST_ASSERT(max_cauchy < 1e-4, "CAUCHY closed form should match the original transform");
+    TEST_ASSERT(max_arcsine < 1e-6, "ARCSINE closed form should match the original transform");
+    return true;
+}
+
+bool test_dist_outside_unit_interval() {
+    gRandGen gen;
+    const float rs[] = {-1.5f, -0.01f, 1.01f, 2.5f};
+
+    for (float r : rs) {
+        TEST_ASSERT(gen.my_rand(LINEAR, r) == 2.f * r - 1.f, "LINEAR should stay linear outside [0, 1]");
+        TEST_ASSERT(gen.my_rand(ARCSINE, r) == dist::arcsine(r), "Inputs outside [0, 1] should use the closed form");
+        TEST_ASSERT(gen.my_rand(LOGISTIC, r) == dist::logistic(r < 0.f ? 0.f : 1.f), "LOGISTIC should clamp its input");
+        TEST_ASSERT(gen.my_rand(EXPONENTIAL, r) == dist::exponential(r < 0.f ? 0.f : 1.f), "EXPONENTIAL should clamp its input");
+    }
+    return true;
+}
+
+bool test_dist_new_distributions_monotonic() {
+    gRandGen gen;
+    const DistType types[] = {LOGISTIC, HYPERBCOS, EXPONENTIAL};
+
+    for (DistType t : types) {
+        float first = gen.my_rand(t, 0.f);
+        float last = gen.my_rand(t, 1.f);
+        float dir = last > first ? 1.f : -1.f;
+        float prev = first;
+        bool monotonic = true;
+        for (int n = 1; n <= 1000; n++) {
+            float v = gen.my_rand(t, n / 1000.f);
+            monotonic &= std::isfinite(v) && (v - prev) * dir >= 0.f;
+            prev = v;
+        }
+        TEST_ASSERT(monotonic, std::string(DISTRIBUTIONS[t].name) + " should be finite and monotonic on [0, 1]");
+        TEST_ASSERT(std::fabs(gen.my_rand(t, 0.5f)) < std::fabs(first) + 1e-6f, "Midpoint should lie inside the output range");
+    }
+
+    TEST_ASSERT(float_equal(gen.my_rand(HYPERBCOS, 0.f), 1.f, 1e-3f), "HYPERBCOS should map 0 to 1");
+    TEST_ASSERT(float_equal(gen.my_rand(EXPONENTIAL, 1.f), 1.f, 1e-5f), "EXPONENTIAL should map 1 to 1");
+    return true;
+}
+
+bool test_dist_unit_range() {
+    // LOGISTIC_C assumes the squash step scales by A like the other
+    // constants, then the ends of [0, 1] map to -1 and 1
+    TEST_ASSERT(float_equal(dist::logistic(0.f), -1.f, 1e-5f), "LOGISTIC should map 0 to -1");
+    TEST_ASSERT(float_equal(dist::logistic(1.f), 1.f, 1e-5f), "LOGISTIC should map 1 to 1");
+
+    for (int d = 0; d < NUM_DISTS; d++) {
+        bool inRange = true;
+        for (int n = 0; n <= 1000; n++) {
+            float v = DISTRIBUTIONS[d].inverse(n / 1000.f);
+            inRange &= v >= -1.f - 1e-5f && v <= 1.f + 1e-5f;
+        }
+        TEST_ASSERT(inRange, std::string(DISTRIBUTIONS[d].name) + " should map [0, 1] into [-1, 1]");
+    }
+    return true;
+}
+
 // ============================================================================
 // Wavetable tests
 // ============================================================================
@@ -520,6 +446,130 @@ bool test_wavetable_edge_case_near_one() {
     return true;
 }
 
+// ============================================================================
+// Fast lookup tests
+// ============================================================================
+
+// Interpolation in double precision with an explicit wrap, used as reference
+double reference_lookup(const Wavetable& wt, double x) {
+    double fx = x * TABLE_SIZE;
+    double fl = std::floor(fx);
+    double ph = fx - fl;
+    long i = ((long) fl % TABLE_SIZE + TABLE_SIZE) % TABLE_SIZE;
+    long j = (i + 1) % TABLE_SIZE;
+    return (1.0 - ph) * wt.table[i] + ph * wt.table[j];
+}
+
+bool test_wavetable_guard_point() {
+    std::vector<EnvType> types = {SIN, TRI, HANN, WELCH, TUKEY};
+
+    for (EnvType type : types) {
+        Wavetable wt(type);
+        TEST_ASSERT(wt.table[TABLE_SIZE] == wt.table[0], "Guard sample should repeat the first sample");
+    }
+
+    Wavetable wt(SIN);
+    wt.switchEnvType(HANN);
+    TEST_ASSERT(wt.table[TABLE_SIZE] == wt.table[0], "Guard sample should be refreshed by switchEnvType()");
+    return true;
+}
+
+bool test_wavetable_get_at_one_wraps() {
+    std::vector<EnvType> types = {SIN, TRI, HANN, WELCH, TUKEY};
+
+    for (EnvType type : types) {
+        Wavetable wt(type);
+        TEST_ASSERT(wt.get(1.0f) == wt.get(0.0f), "get(1.0) should read the guard sample, same as get(0.0)");
+        TEST_ASSERT(wt.index((float) TABLE_SIZE) == wt.table[0], "index(TABLE_SIZE) should wrap to the start");
+    }
+    return true;
+}
+
+bool test_wavetable_get_matches_reference() {
+    std::vector<EnvType> types = {SIN, TRI, HANN, WELCH, TUKEY};
+    srand(7);
+
+    for (EnvType type : types) {
+        Wavetable wt(type);
+        double max_err = 0.0;
+        for (int n = 0; n < 10000; n++) {
+            float x = (float) rand() / RAND_MAX;
+            max_err = std::max(max_err, std::fabs(wt.get(x) - reference_lookup(wt, x)));
+        }
+        TEST_ASSERT(max_err < 1e-5, "get() should match double-precision interpolation");
+    }
+    return true;
+}
+
+bool test_wavetable_get_out_of_range() {
+    Wavetable wt(HANN);
+    const float xs[] = {-3.25f, -1.0f, -0.5f, -1e-6f, 1.5f, 2.0f, 1000.125f};
+
+    for (float x : xs) {
+        float val = wt.get(x);
+        TEST_ASSERT(!std::isnan(val) && !std::isinf(val), "get() should stay in bounds outside [0, 1]");
+        TEST_ASSERT(float_equal(val, (float) reference_lookup(wt, x), 1e-3f),
+                    "get() should wrap around outside [0, 1]");
+    }
+    return true;
+}
+
+bool test_wavetable_get4_matches_get() {
+    std::vector<EnvType> types = {SIN, TRI, HANN, WELCH, TUKEY};
+    srand(11);
+
+    for (EnvType type : types) {
+        Wavetable wt(type);
+        int mismatches = 0;
+        for (int n = 0; n < 2500; n++) {
+            simd::float_4 x;
+            for (int k = 0; k < 4; k++)
+                x[k] = 1.2f * ((float) rand() / RAND_MAX) - 0.1f;
+
+            simd::float_4 v = wt.get4(x);
+            for (int k = 0; k < 4; k++)
+                mismatches += (v[k] != wt.get(x[k]));
+        }
+        TEST_ASSERT(mismatches == 0, "get4() should match get() in every lane");
+
+        simd::float_4 edges = wt.get4(simd::float_4(0.0f, 0.5f, 1.0f - 1.0f / TABLE_SIZE, 1.0f));
+        TEST_ASSERT(edges[0] == wt.get(0.0f), "get4() should handle 0.0");
+        TEST_ASSERT(edges[3] == wt.get(1.0f), "get4() should handle 1.0");
+    }
+    return true;
+}
+
+bool test_wavetable_get_phase() {
+    std::vector<EnvType> types = {SIN, TRI, HANN, WELCH, TUKEY};
+    srand(13);
+
+    for (EnvType type : types) {
+        Wavetable wt(type);
+        TEST_ASSERT(wt.getPhase(0u) == wt.table[0], "getPhase(0) should read the first sample");
+        TEST_ASSERT(float_equal(wt.getPhase(0xFFFFFFFFu), wt.table[0], 1e-2f),
+                    "getPhase() at the end of the cycle should approach the guard sample");
+
+        double max_err = 0.0;
+        for (int n = 0; n < 10000; n++) {
+            uint32_t phase = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+            double x = phase / 4294967296.0;
+            max_err = std::max(max_err, std::fabs(wt.getPhase(phase) - reference_lookup(wt, x)));
+        }
+        TEST_ASSERT(max_err < 1e-5, "getPhase() should match double-precision interpolation");
+    }
+    return true;
+}
+
+bool test_wavetable_get_phase4_matches_get_phase() {
+    Wavetable wt(TUKEY);
+    const uint32_t phases[4] = {0u, 0x40000000u, 0x80000001u, 0xFFFFFFFFu};
+
+    simd::float_4 v = wt.getPhase4(phases);
+    for (int k = 0; k < 4; k++)
+        TEST_ASSERT(v[k] == wt.getPhase(phases[k]), "getPhase4() should match getPhase() in every lane");
+    return true;
+}
+
 // ============================================================================
 // Main test runner
 // ============================================================================
@@ -553,6 +603,15 @@ int main() {
     RUN_TEST(test_gRandGen_boundary_values);
     std::cout << std::endl;
 
+    std::cout << "--- Distribution table tests ---" << std::endl;
+    RUN_TEST(test_dist_table_matches_closed_form);
+    RUN_TEST(test_dist_constants_match_formulas);
+    RUN_TEST(test_dist_closed_forms_match_original);
+    RUN_TEST(test_dist_outside_unit_interval);
+    RUN_TEST(test_dist_new_distributions_monotonic);
+    RUN_TEST(test_dist_unit_range);
+    std::cout << std::endl;
+
     std::cout << "--- Wavetable tests ---" << std::endl;
     RUN_TEST(test_wavetable_default_constructor);
     RUN_TEST(test_wavetable_parameterized_constructor);
@@ -571,6 +630,16 @@ int main() {
     RUN_TEST(test_wavetable_edge_case_near_one);
     std::cout << std::endl;
 
+    std::cout << "--- Fast lookup tests ---" << std::endl;
+    RUN_TEST(test_wavetable_guard_point);
+    RUN_TEST(test_wavetable_get_at_one_wraps);
+    RUN_TEST(test_wavetable_get_matches_reference);
+    RUN_TEST(test_wavetable_get_out_of_range);
+    RUN_TEST(test_wavetable_get4_matches_get);
+    RUN_TEST(test_wavetable_get_phase);
+    RUN_TEST(test_wavetable_get_phase4_matches_get_phase);
+    std::cout << std::endl;
+
     std::cout << "========================================" << std::endl;
     std::cout << "Test Results:" << std::endl;
     std::cout << "  Passed: " << tests_passed << std::endl;
@@ -0,0 +1,588 @@
+/*
+ * ReGrandy_render.cpp
+ * Offline renderer of ReGrandy presets to WAV
+ *
+ * Loads .vcvm presets (e.g. from presets/ReGrandy), sets the module's
+ * params and context-menu settings from them, seeds the random walks and
+ * runs ReGrandy::process for the requested length at any sample rate,
+ * as fast as the CPU allows. Each voice is one channel of the WAV file,
+ * scaled like Rack's Audio module (10 V is full scale). Prints the
+ * render time and the real-time factor, so with --no-output it doubles
+ * as a throughput measurement of the shipped code.
+ *
+ * Given several presets, param sets, sample rates or seeds it renders
+ * every combination as a batch. Each render is a job with its own
+ * module, and so its own oscillators and limiters; the jobs are spread
+ * over all cores by a WorkStealingPool. A batch writes its WAV files
+ * and summary.csv, with the render time of each job, to the -d
+ * directory.
+ *
+ * plugin.cpp and ReGrandy.cpp are compiled as they ship against the
+ * mock SDK in src/tests/mock, so Rack is not needed. Built by
+ * `make render`.
+ *
+ * Usage: ReGrandy_render [options] <preset.vcvm | directory>...
+ *   -o <path>         WAV file of a single render (default <preset>.wav)
+ *   -d <dir>          write a batch to this directory
+ *   -t <seconds>      length of each render (default 10)
+ *   -r <rate,...>     sample rates in Hz (default 48000)
+ *   -s <seed,...>     seeds of the random walks (default 1)
+ *   -p <id=value,...> a param set applied over the preset, repeat the
+ *                     option for more sets (default the preset as is)
+ *   -v <voices>       patch V/Oct with this many channels at 0 V,
+ *                     0 leaves it unpatched (default 0, one voice)
+ *   -j <threads>      worker threads (default one per core)
+ *   --format <f>      f32 or s16 (default f32)
+ *   --no-output       render without writing WAV files
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <sstream>
+#include <mutex>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "../plugin.cpp"
+#include "../ReGrandy.cpp"
+#include "../utils/wavetable.cpp"
+#include "WorkStealingPool.hpp"
+
+namespace
+{
+  // Rack's Audio module maps +-10 V to full scale
+  const float VOLTS_TO_SAMPLE = 0.1f;
+
+  enum SampleFormat
+  {
+    FORMAT_F32,
+    FORMAT_S16
+  };
+
+  // Param values set over those of the preset, by param id
+  typedef std::vector<std::pair<int, float> > ParamSet;
+
+  struct RenderSettings
+  {
+    float sampleRate = 48000.f;
+    double seconds = 10.0;
+    uint64_t seed = 1;
+    int voices = 0;
+    ParamSet params;
+  };
+
+  /*
+   * Params and module data of a preset file
+   */
+  struct Preset
+  {
+    std::string name;
+    ParamSet params;
+    json_t *dataJ = nullptr;
+  };
+
+  bool loadPreset(const std::string &path, Preset &preset, std::string &error)
+  {
+    json_error_t jsonError;
+    json_t *rootJ = json_load_file(path.c_str(), 0, &jsonError);
+    if (!rootJ)
+    {
+      error = path + ":" + std::to_string(jsonError.line) + ": " + jsonError.text;
+      return false;
+    }
+
+    const char *model = json_string_value(json_object_get(rootJ, "model"));
+    if (model && std::strcmp(model, "ReGrandy"))
+    {
+      error = path + ": preset is for " + model + ", not ReGrandy";
+      json_decref(rootJ);
+      return false;
+    }
+
+    // the file name is the preset name in Rack's preset menu
+    size_t slash = path.find_last_of("/\\");
+    preset.name = path.substr(slash == std::string::npos ? 0 : slash + 1);
+    preset.name = preset.name.substr(0, preset.name.rfind(".vcvm"));
+
+    json_t *paramsJ = json_object_get(rootJ, "params");
+    for (size_t i = 0; i < json_array_size(paramsJ); i++)
+    {
+      json_t *paramJ = json_array_get(paramsJ, i);
+      json_t *idJ = json_object_get(paramJ, "id");
+      json_t *valueJ = json_object_get(paramJ, "value");
+      if (idJ && valueJ)
+        preset.params.push_back(std::make_pair((int) json_integer_value(idJ), (float) json_number_value(valueJ)));
+    }
+
+    // the preset keeps a reference to the data after the tree is freed
+    preset.dataJ = json_incref(json_object_get(rootJ, "data"));
+
+    json_decref(rootJ);
+    return true;
+  }
+
+  void setParams(ReGrandy *module, const ParamSet &params)
+  {
+    for (const auto &param : params)
+    {
+      if (param.first >= 0 && param.first < ReGrandy::NUM_PARAMS)
+        module->params[param.first].setValue(param.second);
+    }
+  }
+
+  /*
+   * A module at the given rate with the preset and param set applied,
+   * its outputs patched and its walks seeded. Only reads shared state,
+   * so jobs can create their modules concurrently
+   */
+  ReGrandy *createModule(const Preset &preset, const RenderSettings &settings)
+  {
+    ReGrandy *module = new ReGrandy;
+    Module::SampleRateChangeEvent e = {settings.sampleRate, 1.f / settings.sampleRate};
+    module->onSampleRateChange(e);
+
+    setParams(module, preset.params);
+    setParams(module, settings.params);
+    if (preset.dataJ)
+      module->dataFromJson(preset.dataJ);
+
+    module->outputs[ReGrandy::SINE_OUTPUT].channels = 1;
+    module->outputs[ReGrandy::INV_OUTPUT].channels = 1;
+
+    Input &freq = module->inputs[ReGrandy::FREQ_INPUT];
+    freq.channels = clamp(settings.voices, 0, PORT_MAX_CHANNELS);
+    for (int c = 0; c < freq.channels; c++)
+      freq.voltages[c] = 0.f;
+
+    module->seed(settings.seed);
+    return module;
+  }
+
+  /*
+   * Runs the module for the whole render and returns the interleaved
+   * main output in volts, one channel per voice
+   */
+  std::vector<float> render(ReGrandy *module, const RenderSettings &settings, int &numChannels)
+  {
+    const int64_t numFrames = (int64_t) std::llround(settings.seconds * settings.sampleRate);
+    numChannels = std::max(settings.voices, 1);
+    std::vector<float> out(numFrames * numChannels);
+
+    Module::ProcessArgs args = {settings.sampleRate, 1.f / settings.sampleRate, 0};
+    const Output &sine = module->outputs[ReGrandy::SINE_OUTPUT];
+    float *frame = out.data();
+
+    for (int64_t t = 0; t < numFrames; t++, frame += numChannels)
+    {
+      args.frame = t;
+      module->process(args);
+      std::memcpy(frame, sine.voltages, numChannels * sizeof(float));
+    }
+    return out;
+  }
+
+  template <typename T>
+  void writeLE(std::ofstream &file, T value, int bytes)
+  {
+    for (int i = 0; i < bytes; i++)
+      file.put((char) ((uint64_t) value >> (8 * i)));
+  }
+
+  /*
+   * RIFF WAVE file with IEEE float or 16-bit PCM samples
+   */
+  bool writeWav(const std::string &path, const std::vector<float> &volts, int numChannels, float sampleRate, SampleFormat format)
+  {
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file)
+      return false;
+
+    const int bytesPerSample = format == FORMAT_F32 ? 4 : 2;
+    const uint32_t dataSize = volts.size() * bytesPerSample;
+
+    file.write("RIFF", 4);
+    writeLE(file, 36 + dataSize, 4);
+    file.write("WAVEfmt ", 8);
+    writeLE(file, 16, 4);
+    writeLE(file, format == FORMAT_F32 ? 3 : 1, 2);
+    writeLE(file, numChannels, 2);
+    writeLE(file, (uint32_t) sampleRate, 4);
+    writeLE(file, (uint32_t) sampleRate * numChannels * bytesPerSample, 4);
+    writeLE(file, numChannels * bytesPerSample, 2);
+    writeLE(file, 8 * bytesPerSample, 2);
+    file.write("data", 4);
+    writeLE(file, dataSize, 4);
+
+    for (float v : volts)
+    {
+      float x = v * VOLTS_TO_SAMPLE;
+      if (format == FORMAT_F32)
+      {
+        uint32_t bits;
+        std::memcpy(&bits, &x, 4);
+        writeLE(file, bits, 4);
+      }
+      else
+      {
+        int16_t s = (int16_t) std::lrint(clamp(x, -1.f, 1.f) * 32767.f);
+        writeLE(file, (uint16_t) s, 2);
+      }
+    }
+    return (bool) file;
+  }
+
+  /*
+   * Splits "a,b,c" into its items
+   */
+  std::vector<std::string> splitList(const std::string &list)
+  {
+    std::vector<std::string> items;
+    std::istringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ','))
+    {
+      if (!item.empty())
+        items.push_back(item);
+    }
+    return items;
+  }
+
+  /*
+   * "id=value,id=value" as a param set
+   */
+  bool parseParamSet(const std::string &list, ParamSet &params)
+  {
+    for (const std::string &item : splitList(list))
+    {
+      size_t eq = item.find('=');
+      if (eq == std::string::npos)
+        return false;
+      int id = std::atoi(item.substr(0, eq).c_str());
+      if (id < 0 || id >= ReGrandy::NUM_PARAMS)
+        return false;
+      params.push_back(std::make_pair(id, (float) std::atof(item.substr(eq + 1).c_str())));
+    }
+    return true;
+  }
+
+  /*
+   * The .vcvm files of a directory, sorted, or the path itself if it
+   * is not a directory
+   */
+  std::vector<std::string> listPresets(const std::string &path)
+  {
+    std::vector<std::string> paths;
+    DIR *dir = opendir(path.c_str());
+    if (!dir)
+    {
+      paths.push_back(path);
+      return paths;
+    }
+
+    while (dirent *entry = readdir(dir))
+    {
+      std::string name = entry->d_name;
+      if (name.size() > 5 && name.substr(name.size() - 5) == ".vcvm")
+        paths.push_back(path + "/" + name);
+    }
+    closedir(dir);
+
+    std::sort(paths.begin(), paths.end());
+    return paths;
+  }
+
+  bool makeDirectory(const std::string &path)
+  {
+#ifdef _WIN32
+    mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+  }
+
+  /*
+   * One render of a batch and, once it ran, its result
+   */
+  struct Job
+  {
+    const Preset *preset;
+    int paramSet;
+    RenderSettings settings;
+    std::string wavPath;
+
+    int numChannels = 0;
+    int latency = 0;
+    double renderSeconds = 0.0;
+    float peak = 0.f;
+    bool written = false;
+
+    double realtimeFactor() const
+    {
+      return settings.seconds / renderSeconds;
+    }
+  };
+
+  /*
+   * Renders the job with a module of its own and writes its WAV file
+   */
+  void runJob(Job &job, SampleFormat format, bool writeOutput)
+  {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+
+    ReGrandy *module = createModule(*job.preset, job.settings);
+    std::vector<float> volts = render(module, job.settings, job.numChannels);
+    job.latency = module->getLatency();
+    delete module;
+
+    job.renderSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (float v : volts)
+      job.peak = std::max(job.peak, std::abs(v));
+
+    if (writeOutput)
+      job.written = writeWav(job.wavPath, volts, job.numChannels, job.settings.sampleRate, format);
+  }
+
+  void printJob(const Job &job, int numParamSets)
+  {
+    std::cout << std::fixed << std::setprecision(3)
+              << job.preset->name << ": " << job.settings.seconds << " s at " << std::setprecision(0)
+              << job.settings.sampleRate << " Hz, " << job.numChannels << (job.numChannels == 1 ? " voice" : " voices");
+    if (numParamSets > 1)
+      std::cout << ", param set " << job.paramSet;
+    std::cout << ", seed " << job.settings.seed << std::setprecision(3) << ", rendered in " << job.renderSeconds
+              << " s (" << std::setprecision(1) << job.realtimeFactor() << "x realtime)" << std::endl;
+  }
+
+  bool writeSummary(const std::string &path, const std::vector<Job> &jobs, const std::vector<std::string> &paramSets)
+  {
+    std::ofstream out(path.c_str());
+    if (!out)
+      return false;
+
+    out << "preset,param_set,sample_rate,seed,voices,seconds,render_seconds,realtime_factor,peak_volts,latency_samples,file\n";
+    for (const Job &job : jobs)
+    {
+      out << "\"" << job.preset->name << "\",\"" << paramSets[job.paramSet] << "\","
+          << std::setprecision(0) << std::fixed << job.settings.sampleRate << "," << job.settings.seed << ","
+          << job.numChannels << "," << std::setprecision(3) << job.settings.seconds << ","
+          << std::setprecision(6) << job.renderSeconds << "," << std::setprecision(1) << job.realtimeFactor() << ","
+          << std::setprecision(3) << job.peak << "," << job.latency << ",\"" << (job.written ? job.wavPath : "") << "\"\n";
+    }
+    return (bool) out;
+  }
+
+  void usage(const char *program)
+  {
+    std::cerr << "usage: " << program << " [-o <path> | -d <dir>] [-t <seconds>] [-r <rate,...>] [-s <seed,...>]"
+              << " [-p <id=value,...>]... [-v <voices>] [-j <threads>] [--format f32|s16] [--no-output]"
+              << " <preset.vcvm | directory>..." << std::endl;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  RenderSettings base;
+  SampleFormat format = FORMAT_F32;
+  std::vector<std::string> presetPaths, paramSetLists;
+  std::vector<float> sampleRates;
+  std::vector<uint64_t> seeds;
+  std::string wavPath, batchDir;
+  int numThreads = 0;
+  bool writeOutput = true;
+
+  for (int i = 1; i < argc; i++)
+  {
+    bool hasValue = i + 1 < argc;
+    if (!std::strcmp(argv[i], "-o") && hasValue)
+      wavPath = argv[++i];
+    else if (!std::strcmp(argv[i], "-d") && hasValue)
+      batchDir = argv[++i];
+    else if (!std::strcmp(argv[i], "-t") && hasValue)
+      base.seconds = std::atof(argv[++i]);
+    else if (!std::strcmp(argv[i], "-r") && hasValue)
+    {
+      for (const std::string &rate : splitList(argv[++i]))
+        sampleRates.push_back(std::atof(rate.c_str()));
+    }
+    else if (!std::strcmp(argv[i], "-s") && hasValue)
+    {
+      for (const std::string &seed : splitList(argv[++i]))
+        seeds.push_back(std::strtoull(seed.c_str(), nullptr, 10));
+    }
+    else if (!std::strcmp(argv[i], "-p") && hasValue)
+      paramSetLists.push_back(argv[++i]);
+    else if (!std::strcmp(argv[i], "-v") && hasValue)
+      base.voices = std::atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "-j") && hasValue)
+      numThreads = std::atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "--format") && hasValue)
+    {
+      std::string f = argv[++i];
+      if (f != "f32" && f != "s16")
+      {
+        usage(argv[0]);
+        return 1;
+      }
+      format = f == "f32" ? FORMAT_F32 : FORMAT_S16;
+    }
+    else if (!std::strcmp(argv[i], "--no-output"))
+      writeOutput = false;
+    else if (argv[i][0] != '-')
+    {
+      for (const std::string &path : listPresets(argv[i]))
+        presetPaths.push_back(path);
+    }
+    else
+    {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (sampleRates.empty())
+    sampleRates.push_back(base.sampleRate);
+  if (seeds.empty())
+    seeds.push_back(base.seed);
+  if (paramSetLists.empty())
+    paramSetLists.push_back("");
+
+  std::vector<ParamSet> paramSets(paramSetLists.size());
+  for (size_t i = 0; i < paramSetLists.size(); i++)
+  {
+    if (!parseParamSet(paramSetLists[i], paramSets[i]))
+    {
+      std::cerr << "Bad param set \"" << paramSetLists[i] << "\", expected id=value,..." << std::endl;
+      return 1;
+    }
+  }
+
+  bool badRate = false;
+  for (float rate : sampleRates)
+    badRate |= rate < 1000.f;
+
+  if (presetPaths.empty() || base.seconds <= 0.0 || badRate
+      || base.voices < 0 || base.voices > PORT_MAX_CHANNELS)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // builds the shared tables and picks the kernels like Rack does
+  Plugin restock;
+  init(&restock);
+
+  std::vector<Preset> presets(presetPaths.size());
+  for (size_t i = 0; i < presetPaths.size(); i++)
+  {
+    std::string error;
+    if (!loadPreset(presetPaths[i], presets[i], error))
+    {
+      std::cerr << error << std::endl;
+      return 1;
+    }
+  }
+
+  // every combination of preset, param set, sample rate and seed
+  std::vector<Job> jobs;
+  for (const Preset &preset : presets)
+    for (size_t p = 0; p < paramSets.size(); p++)
+      for (float rate : sampleRates)
+        for (uint64_t seed : seeds)
+        {
+          Job job;
+          job.preset = &preset;
+          job.paramSet = p;
+          job.settings = base;
+          job.settings.sampleRate = rate;
+          job.settings.seed = seed;
+          job.settings.params = paramSets[p];
+
+          std::ostringstream name;
+          name << preset.name;
+          if (paramSets.size() > 1)
+            name << "_p" << p;
+          name << "_" << (int) rate << "_s" << seed << ".wav";
+          job.wavPath = batchDir + "/" + name.str();
+          jobs.push_back(job);
+        }
+
+  const bool batch = !batchDir.empty();
+  if (!batch)
+  {
+    if (jobs.size() > 1)
+    {
+      std::cerr << "Rendering " << jobs.size() << " combinations needs a directory, -d <dir>" << std::endl;
+      return 1;
+    }
+    jobs[0].wavPath = wavPath.empty() ? presets[0].name + ".wav" : wavPath;
+  }
+  else if (!makeDirectory(batchDir))
+  {
+    std::cerr << "Could not create " << batchDir << std::endl;
+    return 1;
+  }
+
+  WorkStealingPool pool(std::min(numThreads > 0 ? numThreads : WorkStealingPool().size(), (int) jobs.size()));
+  std::mutex printMutex;
+
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point start = Clock::now();
+
+  pool.run(jobs.size(), [&](int index, int worker) {
+    runJob(jobs[index], format, writeOutput);
+    std::lock_guard<std::mutex> lock(printMutex);
+    printJob(jobs[index], paramSets.size());
+  });
+
+  double wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  for (Preset &preset : presets)
+    json_decref(preset.dataJ);
+
+  bool failed = false;
+  double audioSeconds = 0.0, cpuSeconds = 0.0;
+  for (const Job &job : jobs)
+  {
+    audioSeconds += job.settings.seconds;
+    cpuSeconds += job.renderSeconds;
+    if (writeOutput && !job.written)
+    {
+      std::cerr << "Could not write " << job.wavPath << std::endl;
+      failed = true;
+    }
+  }
+
+  std::cout << std::fixed << std::setprecision(3) << jobs.size() << (jobs.size() == 1 ? " render, " : " renders, ")
+            << audioSeconds << " s of audio in " << wallSeconds << " s on " << pool.size()
+            << (pool.size() == 1 ? " thread" : " threads") << " (" << std::setprecision(1)
+            << audioSeconds / wallSeconds << "x realtime, " << std::setprecision(3) << cpuSeconds
+            << " s rendering in all jobs, kernels "
+            << simdLevelName(activeSimdLevel()) << ")" << std::endl;
+
+  if (batch)
+  {
+    std::string summaryPath = batchDir + "/summary.csv";
+    if (!writeSummary(summaryPath, jobs, paramSetLists))
+    {
+      std::cerr << "Could not write " << summaryPath << std::endl;
+      return 1;
+    }
+    std::cout << "Summary written to " << summaryPath << std::endl;
+  }
+  else if (writeOutput && !failed)
+    std::cout << "Written to " << jobs[0].wavPath << std::endl;
+
+  return failed ? 1 : 0;
+}
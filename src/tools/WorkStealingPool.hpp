@@ -0,0 +1,96 @@
+/*
+ * WorkStealingPool.hpp
+ *
+ * Runs a batch of independent tasks on all cores. Tasks are dealt to
+ * one queue per worker up front; a worker takes from the front of its
+ * own queue and, once that is empty, steals from the back of the
+ * others, so a few long tasks do not leave the other cores idle.
+ */
+
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+struct WorkStealingPool
+{
+  explicit WorkStealingPool(int numThreads = 0)
+  {
+    if (numThreads <= 0)
+      numThreads = std::max((int) std::thread::hardware_concurrency(), 1);
+    numQueues = numThreads;
+    queues.reset(new Queue[numQueues]);
+  }
+
+  int size() const
+  {
+    return numQueues;
+  }
+
+  /*
+   * Calls task(index, worker) once for every index in [0, numTasks)
+   * and returns when all of them are done. Tasks must not share
+   * mutable state, worker is the index of the calling thread.
+   */
+  template <typename F>
+  void run(int numTasks, F task)
+  {
+    for (int i = 0; i < numTasks; i++)
+      queues[i % size()].tasks.push_back(i);
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < size(); w++)
+    {
+      threads.push_back(std::thread([this, w, &task]() {
+        int index;
+        while (take(w, index))
+          task(index, w);
+      }));
+    }
+    for (std::thread &thread : threads)
+      thread.join();
+  }
+
+private:
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<int> tasks;
+  };
+
+  std::unique_ptr<Queue[]> queues;
+  int numQueues;
+
+  bool take(int worker, int &index)
+  {
+    {
+      Queue &own = queues[worker];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if (!own.tasks.empty())
+      {
+        index = own.tasks.front();
+        own.tasks.pop_front();
+        return true;
+      }
+    }
+
+    // no task is added once run() started, so finding every queue
+    // empty means the batch is done
+    for (int i = 1; i < size(); i++)
+    {
+      Queue &victim = queues[(worker + i) % size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.tasks.empty())
+      {
+        index = victim.tasks.back();
+        victim.tasks.pop_back();
+        return true;
+      }
+    }
+    return false;
+  }
+};
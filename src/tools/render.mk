@@ -0,0 +1,20 @@
+# Build rule of the offline and batch renderer, see ReGrandy_render.cpp.
+# It builds against the mock SDK in src/tests/mock and never reads the
+# Rack plugin framework, so it also runs on its own from the repository
+# root, on machines without the SDK:
+#
+#   make -f src/tools/render.mk
+
+# -pthread for the worker threads of a batch
+RENDER_FLAGS := -std=c++11 -O3 -funsafe-math-optimizations -pthread -I./src -I./src/tests/mock
+ifeq ($(shell uname -m), x86_64)
+  RENDER_FLAGS += -march=nehalem
+endif
+
+render: build/tools/ReGrandy_render
+
+build/tools/ReGrandy_render: $(wildcard src/tools/*) $(wildcard src/*.cpp src/*.hpp src/utils/*) src/tests/mock/rack.hpp
+	@mkdir -p $(@D)
+	$(CXX) $(RENDER_FLAGS) src/tools/ReGrandy_render.cpp -o $@ -lm
+
+.PHONY: render
@@ -4,6 +4,10 @@
  *
  * Implementation of a singular generator using granular stochastic
  * dynamic synthesis
+ *
+ * All per-voice state is held in simd::float_4 lanes, so a single
+ * GendyOscillator steps four independent voices at once. Breakpoint
+ * events are rare and handled lane by lane.
  */
 
 #ifndef __GRANDYOSC_HPP__
@@ -13,171 +17,524 @@
 #include "dsp/digital.hpp"
 
 #include "wavetable.hpp"
+#include "Xoshiro.hpp"
+#include "SimdDispatch.hpp"
 
 #define MAX_BPTS 50
 
+// breakpoints one voice may pass in a single sample. The segment rate
+// freq * num_bpts is clamped to this many per sample, which leaves the
+// module's highest setting, 3000 Hz with 50 breakpoints (3.4 per sample
+// at 44.1 kHz), unchanged
+#define MAX_SEGMENTS_PER_SAMPLE 4
+
 namespace rack {
+  using simd::float_4;
+
   struct GendyOscillator {
-    float phase = 1.f;
+    static constexpr uint32_t HALF_PHASE = 0x80000000u;
+
+    float_4 phase = 1.f;
     
     bool GRAN_ON = true;
     bool is_fm_on = true; 
     bool is_mirroring = false;
 
-    int num_bpts = 12;
+    int num_bpts[4] = {12, 12, 12, 12};
     int min_freq = 30; 
     int max_freq = 1000;
 
-    float amps[MAX_BPTS] = {0.f};
-    float durs[MAX_BPTS] = {1.f};
-    float offs[MAX_BPTS] = {0.f};
-    float rats[MAX_BPTS] = {1.f};
+    // one float_4 per breakpoint, lane i belongs to voice i
+    float_4 amps[MAX_BPTS] = {0.f};
+    float_4 durs[MAX_BPTS] = {1.f};
+    float_4 offs[MAX_BPTS] = {0.f};
+    float_4 rats[MAX_BPTS] = {1.f};
 
-    int index = 0;
-    float amp = 0.0; 
-    float amp_next = amps[0];
+    int index[4] = {0, 0, 0, 0};
+    float_4 amp = 0.f; 
+    float_4 amp_next = amps[0];
     
-    float max_amp_step = 0.05f;
-    float max_dur_step = 0.05f;
+    float_4 max_amp_step = 0.05f;
+    float_4 max_dur_step = 0.05f;
     float max_off_step = 0.005f;
     float max_rat_step = 0.01f;
 
-    float speed = 0.0;
-    float rate = 0.0;
+    float_4 speed = 0.f;
+    float_4 rate = 0.f;
+
+    float_4 freq_mul = 1.f;
 
-    float freq_mul = 1.0;
+    // Grain and FM phases are 32-bit fixed point with one cycle per
+    // 2^32, so they wrap on overflow and index the tables directly
 
     // vars for grain offsets
-    float off = 0.0;
-    float off_next = 0.0;
+    uint32_t off[4] = {0, 0, 0, 0};
+    uint32_t off_next[4] = {0, 0, 0, 0};
+
+    uint32_t g_idx[4] = {0, 0, 0, 0};
+    uint32_t g_idx_next[4] = {HALF_PHASE, HALF_PHASE, HALF_PHASE, HALF_PHASE};
 
-    float g_idx = 0.f;
-    float g_idx_next = 0.5f;
+    float_4 g_amp = 0.f;
+    float_4 g_amp_next = 0.f;
+    float_4 g_rate = 1.f;
 
-    float g_amp = 0.f;
-    float g_amp_next = 0.f;
-    float g_rate = 1.f;
+    float_4 rat = 1.f;
+    float_4 rat_next = 1.f;
 
-    float rat = 1.f;
-    float rat_next = 1.f;
+    // keeps the shared tables alive, must come before sample and env
+    WavetableRegistry::Handle tables;
 
-    Wavetable sample = Wavetable(SIN);
-    Wavetable env = Wavetable(TRI); 
+    const Wavetable *sample = WavetableRegistry::get(SIN);
+    const Wavetable *env = WavetableRegistry::get(TRI);
+
+    // envelope being faded out after setEnvelope(), env_fade is its
+    // weight and falls to zero by env_fade_step per sample
+    const Wavetable *env_prev = env;
+    float env_fade = 0.f;
+    float env_fade_step = 0.f;
 
     DistType dt = LINEAR;
     gRandGen rg;
+
+    // random walk streams, one generator per voice lane
+    Xoshiro128x4 rng[4];
+
+    // With lookahead on, the random walk for each lane's next breakpoint
+    // is taken one segment early, at most one lane per sample, so the
+    // breakpoint itself only swaps values in. Parameter changes then
+    // reach the walk one segment later.
+    bool lookahead = true;
+
+    // walked {amp, dur, off, rat} of breakpoint pending_k[i] for lane i,
+    // pending_k[i] is -1 until they are taken
+    float_4 pending[4];
+    int pending_k[4] = {-1, -1, -1, -1};
+
+    // lanes whose next walk has not been taken yet
+    int walk_due = 0xf;
+
+    // random walk of the kernel of the current block
+    float_4 (GendyOscillator::*walker)(int i, int k) = &GendyOscillator::walk<false, LINEAR>;
     
-    float amp_out = 0.f;
+    float_4 amp_out = 0.f;
 
     // for fm synthesis in grain
-    float f_mod = 400.f;
-    float f_car = 800.f;
+    float_4 f_mod = 400.f;
+    float_4 f_car = 800.f;
     
-    // need these to keep track of modulated carrier frequency for either
-    // grain in the synthesis
-    float f_car1 = f_car;
-    float f_car2 = f_car;
+    // modulated carrier frequency, the same for either grain in the
+    // synthesis as they share the modulator
+    float_4 f_car_mod = f_car;
 
     // fm modulation index
-    float i_mod = 100.f;
+    float_4 i_mod = 100.f;
 
-    float phase_mod1 = 0.f;
-    float phase_mod2 = 0.f;
+    uint32_t phase_mod[4] = {0, 0, 0, 0};
     
-    float phase_car1 = 0.f;
-    float phase_car2 = 0.f;
+    uint32_t phase_car1[4] = {0, 0, 0, 0};
+    uint32_t phase_car2[4] = {0, 0, 0, 0};
+
+    // values of the audio-rate parameters reached at the end of the last
+    // block, processBlock() ramps from these to the current fields
+    float_4 g_rate_prev = g_rate;
+    float_4 f_mod_prev = f_mod;
+    float_4 f_car_prev = f_car;
+    float_4 i_mod_prev = i_mod;
 
     // only true when just reached last break point
-    bool last_flag = false;
+    bool last_flag[4] = {false, false, false, false};
 
     int count = 0;
 
-    float freq = 261.626f;
+    float_4 freq = 261.626f;
+
+    GendyOscillator() {
+      seed(random::u64());
+    }
+
+    /*
+     * Restart the random walks from a seed, the same seed gives the same
+     * walks. Each voice lane gets its own streams derived from it.
+     */
+    void seed(uint64_t s) {
+      for (int i = 0; i < 4; i++) {
+        rng[i].seed(Xoshiro128x4::splitmix64(s));
+        pending_k[i] = -1;
+      }
+      walk_due = 0xf;
+    }
+
+    /*
+     * Switch to another shared envelope table. With fadeSamples > 0 the
+     * old envelope is crossfaded into the new one over that many
+     * samples, otherwise the switch is immediate.
+     */
+    void setEnvelope(const Wavetable *e, int fadeSamples) {
+      if (e == env)
+        return;
+
+      if (fadeSamples > 0) {
+        env_prev = env;
+        env_fade = 1.f;
+        env_fade_step = 1.f / fadeSamples;
+      }
+      else {
+        env_fade = 0.f;
+      }
+      env = e;
+    }
 
+    /*
+     * Render one sample of every lane, the result is read with out()
+     */
     void process(float deltaTime) {
-      last_flag = false;
-      if (phase >= 1.0) {
-        
-        //DEBUG("-- PHASE: %f ; G_IDX: %f ; G_IDX_NEXT: %f", phase, g_idx, g_idx_next);
-        phase -= 1.0;
-
-        amp = amp_next;
-        rat = rat_next;
-        index = (index + 1) % num_bpts;
-       
-        last_flag = index == num_bpts - 1;
-
-        /* adjust vals */
-        if (is_mirroring) {
-          amps[index] = mirror(amps[index] + (max_amp_step * rg.my_rand(dt, random::normal())), -1.0f, 1.0f); 
-          durs[index] = mirror(durs[index] + (max_dur_step * rg.my_rand(dt, random::normal())), 0.5f, 1.5f);
-          offs[index] = mirror(offs[index] + (max_off_step * rg.my_rand(dt, random::normal())), 0.f, 1.0f);
-          rats[index] = mirror(rats[index] + (max_off_step * rg.my_rand(dt, random::normal())), 0.7f, 1.3f);
+      processBlock(&amp_out, 1, deltaTime);
+    }
+
+    /*
+     * Render n samples of every lane into out. Parameter fields are
+     * latched once at the start of the block, changes made to them
+     * take effect on the next block. The audio-rate parameters (g_rate,
+     * f_mod, f_car and i_mod) are ramped linearly across the block from
+     * their previous values, so control-rate updates do not zipper.
+     * The grain and modulator phase increments are converted to fixed
+     * point once per block and ramped in integer steps.
+     */
+    void processBlock(float_4* out, int n, float deltaTime) {
+      processBlock(out, n, deltaTime, getKernel(is_fm_on, is_mirroring, dt));
+    }
+
+    /*
+     * The code for one combination of FM mode, mirroring and
+     * distribution. The per-sample loop only depends on the FM mode,
+     * mirroring and distribution only on the random walk taken at
+     * breakpoints, so they are compiled separately and the walk is
+     * called through a pointer.
+     */
+    struct Kernel {
+      void (GendyOscillator::*render)(float_4* out, int n, float deltaTime);
+      float_4 (GendyOscillator::*walk)(int i, int k);
+    };
+
+    /*
+     * Kernel for the given modes, out-of-range distributions get the
+     * LINEAR walk. The loop is the variant built for level.
+     */
+    static const Kernel &getKernel(bool fm, bool mirroring, DistType d, SimdLevel level = activeSimdLevel());
+
+    /*
+     * processBlock() with a kernel picked by the caller, is_fm_on,
+     * is_mirroring and dt are ignored
+     */
+    void processBlock(float_4* out, int n, float deltaTime, const Kernel &k) {
+      walker = k.walk;
+      (this->*k.render)(out, n, deltaTime);
+    }
+
+    template <bool FM>
+    void render(float_4* out, int n, float deltaTime) {
+      renderBlock<FM, SIMD_GENERIC>(out, n, deltaTime);
+    }
+
+    template <bool FM>
+    SIMD_TARGET_AVX2 void renderAvx2(float_4* out, int n, float deltaTime) {
+      renderBlock<FM, SIMD_AVX2>(out, n, deltaTime);
+    }
+
+    template <bool FM, SimdLevel LEVEL>
+    SIMD_INLINE void renderBlock(float_4* out, int n, float deltaTime) {
+      const float ramp = 1.f / n;
+
+      float_4 car = f_car_prev;
+      float_4 index_mod = i_mod_prev;
+
+      const float_4 car_inc = (f_car - f_car_prev) * ramp;
+      const float_4 index_mod_inc = (i_mod - i_mod_prev) * ramp;
+
+      uint32_t g_step[4], g_step_inc[4];
+      uint32_t mod_step[4], mod_step_inc[4];
+
+      for (int i = 0; i < 4; i++) {
+        g_step[i] = toPhase(g_rate_prev[i] * deltaTime);
+        g_step_inc[i] = rampStep(g_step[i], toPhase(g_rate[i] * deltaTime), n);
+        mod_step[i] = toPhase(f_mod_prev[i] * deltaTime);
+        mod_step_inc[i] = rampStep(mod_step[i], toPhase(f_mod[i] * deltaTime), n);
+      }
+
+      g_rate_prev = g_rate;
+      f_mod_prev = f_mod;
+      f_car_prev = f_car;
+      i_mod_prev = i_mod;
+
+      for (int t = 0; t < n; t++) {
+        for (int i = 0; i < 4; i++) {
+          g_step[i] += g_step_inc[i];
+          mod_step[i] += mod_step_inc[i];
         }
-        else {
-          amps[index] = wrap(amps[index] + (max_amp_step * rg.my_rand(dt, random::normal())), -1.0f, 1.0f); 
-          durs[index] = wrap(durs[index] + (max_dur_step * rg.my_rand(dt, random::normal())), 0.5f, 1.5f);
-          offs[index] = wrap(offs[index] + (max_off_step * rg.my_rand(dt, random::normal())), 0.f, 1.0f);
-          rats[index] = wrap(rats[index] + (max_off_step * rg.my_rand(dt, random::normal())), 0.7f, 1.3f);
+        car += car_inc;
+        index_mod += index_mod_inc;
+
+        // lanes whose phase reached the next breakpoint
+        int events = simd::movemask(phase >= 1.f);
+
+        // lanes whose segments are shorter than a sample, their output
+        // is the mean over the sample instead of a point on one segment
+        int dense = 0;
+        float_4 box = 0.f;
+
+        for (int i = 0; i < 4; i++) {
+          last_flag[i] = false;
+          if (events & (1 << i)) {
+            if (speed[i] > 1.f) {
+              box[i] = advanceDense(i, deltaTime);
+              dense |= 1 << i;
+            }
+            else {
+              advanceBreakpoint(i, deltaTime);
+            }
+          }
         }
-        
-        amp_next = amps[index];
-        rate = durs[index];
-        rat_next = rats[index];
-
-        /* step/adjust grain sample offsets */
-        off = off_next;
-        off_next = offs[index];
-    
-        g_idx = g_idx_next;
-        g_idx_next = 0.0;
 
-        //speed = ((max_freq - min_freq) * rate + min_freq) * deltaTime * num_bpts; 
-        speed = freq * deltaTime * num_bpts;
-        
-        //speed *= freq_mul;
-      }
-     
-      if (!is_fm_on) {
+        if (lookahead && walk_due)
+          walkAhead();
+
+        float_4 e = lookup<LEVEL>(env, g_idx);
+        float_4 e_next = lookup<LEVEL>(env, g_idx_next);
+
+        if (env_fade > 0.f) {
+          e += (lookup<LEVEL>(env_prev, g_idx) - e) * env_fade;
+          e_next += (lookup<LEVEL>(env_prev, g_idx_next) - e_next) * env_fade;
+          env_fade -= env_fade_step;
+        }
        
-        g_amp = amp + (env.get(g_idx) * sample.get(off));
-        g_amp_next = amp_next + (env.get(g_idx_next) * sample.get(off_next));
-        
+        if (!FM) {
+          float_4 s = lookup<LEVEL>(sample, off);
+          float_4 s_next = lookup<LEVEL>(sample, off_next);
+         
+          g_amp = amp + (e * s);
+          g_amp_next = amp_next + (e_next * s_next);
+        } else {
+          g_amp = amp + (e * sinUnit(toFloat(phase_car1)));
+          g_amp_next = amp_next + (e_next * sinUnit(toFloat(phase_car2)));
+        }
+
         // linear interpolation
-        amp_out = ((1.0 - phase) * g_amp) + (phase * g_amp_next); 
-      } else {
-        //amp_out = ((1.0 - phase) * amp) + (phase * amp_next); 
-        g_amp = amp + (env.get(g_idx) * sinf(phase_car1));
-        g_amp_next = amp_next + (env.get(g_idx_next) * sinf(phase_car2));
-        amp_out = ((1.0 - phase) * g_amp) + (phase * g_amp_next); 
+        amp_out = ((1.f - phase) * g_amp) + (phase * g_amp_next); 
+
+        for (int i = 0; dense && i < 4; i++) {
+          if (dense & (1 << i))
+            amp_out[i] += box[i] - ((1.f - phase[i]) * amp[i] + phase[i] * amp_next[i]);
+        }
+
+        out[t] = amp_out;
+
+        phase += speed;
+
+        // the carriers are modulated every sample, so their increments
+        // are the only ones converted in the inner loop
+        const float_4 car_step1 = deltaTime * f_car_mod * rat;
+        const float_4 car_step2 = deltaTime * f_car_mod * rat_next;
+
+        for (int i = 0; i < 4; i++) {
+          // advance the grain envelope indices
+          g_idx[i] += g_step[i];
+          g_idx_next[i] += g_step[i];
+
+          off[i] += g_step[i];
+          off_next[i] += g_step[i];
+
+          // step phases for fm in grans
+          phase_car1[i] += toPhase(car_step1[i]);
+          phase_car2[i] += toPhase(car_step2[i]);
+
+          phase_mod[i] += mod_step[i];
+        }
+
+        // one lookup per sample, the grains step the modulator alike
+        float_4 m = lookup<LEVEL>(sample, phase_mod);
+
+        // |f_car| <= 5000 and |i_mod| < 12000, so the carriers stay well
+        // inside +-22050 Hz and need no further wrapping
+        f_car_mod = car + (index_mod * m);
+      
+        count++;
       }
+    }
+
+    /*
+     * Step voice i onto its next breakpoint and take a new random walk
+     * step for that breakpoint, or use the one walkAhead() took for it
+     */
+    void advanceBreakpoint(int i, float deltaTime) {
+      //DEBUG("-- PHASE: %f ; G_IDX: %f ; G_IDX_NEXT: %f", phase[i], g_idx[i], g_idx_next[i]);
+      phase[i] -= 1.f;
+
+      amp[i] = amp_next[i];
+      rat[i] = rat_next[i];
+      index[i] = (index[i] + 1) % num_bpts[i];
+     
+      last_flag[i] = index[i] == num_bpts[i] - 1;
 
-      // advance the grain envelope indices
-      g_idx = fmod(g_idx + (g_rate * deltaTime), 1.f);
-      g_idx_next = fmod(g_idx_next + (g_rate * deltaTime), 1.f);
+      int k = index[i];
 
-      off = fmod(off + (g_rate * deltaTime), 1.f);
-      off_next = fmod(off_next + (g_rate * deltaTime), 1.f);
+      // num_bpts may have changed since the walk was taken
+      float_4 v = (pending_k[i] == k) ? pending[i] : (this->*walker)(i, k);
+      pending_k[i] = -1;
+      walk_due |= 1 << i;
+
+      amps[k][i] = v[0];
+      durs[k][i] = v[1];
+      offs[k][i] = v[2];
+      rats[k][i] = v[3];
+      
+      amp_next[i] = amps[k][i];
+      rate[i] = durs[k][i];
+      rat_next[i] = rats[k][i];
+
+      /* step/adjust grain sample offsets */
+      off[i] = off_next[i];
+      off_next[i] = toPhase(offs[k][i]);
+  
+      g_idx[i] = g_idx_next[i];
+      g_idx_next[i] = 0;
+
+      //speed = ((max_freq - min_freq) * rate + min_freq) * deltaTime * num_bpts; 
+      speed[i] = std::min(freq[i] * deltaTime * num_bpts[i], (float) MAX_SEGMENTS_PER_SAMPLE);
       
-      phase += speed;
+      //speed *= freq_mul;
+    }
 
-      // step phases and frequencies for fm in grans
-      phase_car1 += deltaTime * f_car1 * rat;
-      phase_car2 += deltaTime * f_car2 * rat_next;
+    /*
+     * Random walk step of breakpoint k of voice i, returned as the new
+     * {amp, dur, off, rat}. Breakpoint k itself is left as it is.
+     */
+    template <bool MIRROR, DistType DT>
+    float_4 walk(int i, int k) {
+      // one uniform each for amps, durs, offs and rats
+      float_4 u = rng[i].uniform4();
+      float_4 v;
+
+      /* adjust vals */
+      v[0] = bound<MIRROR>(amps[k][i] + (max_amp_step[i] * rg.my_rand<DT>(u[0])), -1.0f, 1.0f); 
+      v[1] = bound<MIRROR>(durs[k][i] + (max_dur_step[i] * rg.my_rand<DT>(u[1])), 0.5f, 1.5f);
+      v[2] = bound<MIRROR>(offs[k][i] + (max_off_step * rg.my_rand<DT>(u[2])), 0.f, 1.0f);
+      v[3] = bound<MIRROR>(rats[k][i] + (max_off_step * rg.my_rand<DT>(u[3])), 0.7f, 1.3f);
+
+      return v;
+    }
 
-      phase_car1 = fmod(phase_car1, 1.f);
-      phase_car2 = fmod(phase_car2, 1.f);
+    /*
+     * mirror() or wrap() of a walked value
+     */
+    template <bool MIRROR>
+    float bound(float in, float lb, float ub) {
+      return MIRROR ? mirror(in, lb, ub) : wrap(in, lb, ub);
+    }
 
-      phase_mod1 += deltaTime * f_mod;
-      phase_mod2 += deltaTime * f_mod;
+    /*
+     * Take the walk of the next breakpoint of one lane that is due, so
+     * a breakpoint shared by all four lanes costs one walk per sample
+     * over the following samples rather than four in one. Lanes with
+     * segments shorter than a sample are left out: advanceDense() walks
+     * every breakpoint they pass, so a walk ahead would only cover the
+     * first and keep the other lanes waiting.
+     */
+    void walkAhead() {
+      const int due = walk_due & ~simd::movemask(speed > 1.f);
+      if (!due)
+        return;
+
+      int i = 0;
+      while (!(due & (1 << i)))
+        i++;
+
+      int k = (index[i] + 1) % num_bpts[i];
+      pending[i] = (this->*walker)(i, k);
+      pending_k[i] = k;
+      walk_due &= ~(1 << i);
+    }
 
-      phase_mod1 = fmod(phase_mod1, 1.f);
-      phase_mod2 = fmod(phase_mod2, 1.f);
+    /*
+     * Step voice i over every breakpoint its phase has passed, at most
+     * MAX_SEGMENTS_PER_SAMPLE as speed is clamped to it, and return the
+     * mean of the piecewise linear amplitude over the sample. Segments
+     * shorter than a sample are box-filtered instead of stretched.
+     */
+    float advanceDense(int i, float deltaTime) {
+      // the previous sample sat at p0 on the current segment
+      const float p0 = clamp(phase[i] - speed[i], 0.f, 1.f);
+      float v0 = amp[i] + (amp_next[i] - amp[i]) * p0;
+
+      float area = 0.5f * (v0 + amp_next[i]) * (1.f - p0);
+      float width = 1.f - p0;
+
+      const int n = std::min((int) phase[i], MAX_SEGMENTS_PER_SAMPLE);
+      for (int k = 0; k < n; k++) {
+        advanceBreakpoint(i, deltaTime);
+
+        // whole segments passed within the sample
+        if (k < n - 1) {
+          area += 0.5f * (amp[i] + amp_next[i]);
+          width += 1.f;
+        }
+      }
 
-      f_car1 = fmod(f_car + (i_mod * sample.get(phase_mod1)), 22050.f);
-      f_car2 = fmod(f_car + (i_mod * sample.get(phase_mod2)), 22050.f);
-    
-      count++;
+      // phase < 1 + MAX_SEGMENTS_PER_SAMPLE, this only absorbs rounding
+      phase[i] -= (int) phase[i];
+
+      float p1 = phase[i];
+      float v1 = amp[i] + (amp_next[i] - amp[i]) * p1;
+      area += 0.5f * (amp[i] + v1) * p1;
+      width += p1;
+
+      return area / width;
+    }
+
+    /*
+     * Wavetable::getPhase4(), with the AVX2 gather in the AVX2 variant
+     */
+    template <SimdLevel LEVEL>
+    static SIMD_INLINE float_4 lookup(const Wavetable *w, const uint32_t *phase) {
+#if SIMD_DISPATCH
+      if (LEVEL != SIMD_GENERIC)
+        return w->getPhase4Avx2(phase);
+#endif
+      return w->getPhase4(phase);
+    }
+
+    /*
+     * Fixed-point phase of x cycles, wrapped modulo one cycle
+     */
+    static uint32_t toPhase(float x) {
+      return (uint32_t) (int64_t) (x * 4294967296.f);
+    }
+
+    /*
+     * Phases of four lanes as floats in [0, 1)
+     */
+    static SIMD_INLINE float_4 toFloat(const uint32_t *phase) {
+      float_4 r;
+      for (int i = 0; i < 4; i++)
+        r[i] = (float) (phase[i] >> 8) * (1.f / 16777216.f);
+      return r;
+    }
+
+    /*
+     * sin(x) for x in [0, 1], which is all the carrier phases reach. The
+     * Taylor series up to x^9 is within 3e-8 there and is much cheaper
+     * than the range-reduced simd::sin.
+     */
+    static SIMD_INLINE float_4 sinUnit(float_4 x) {
+      float_4 x2 = x * x;
+      return x * (1.f + x2 * (-1.f / 6.f + x2 * (1.f / 120.f + x2 * (-1.f / 5040.f + x2 * (1.f / 362880.f)))));
+    }
+
+    /*
+     * Per-sample step that ramps a phase increment from `from` to `to`
+     * over n samples
+     */
+    static uint32_t rampStep(uint32_t from, uint32_t to, int n) {
+      return (uint32_t) ((int32_t) (to - from) / n);
     }
 
     float wrap(float in, float lb, float ub) {
@@ -200,11 +557,43 @@ namespace rack {
       return out;
     }
     
-    float out() {
+    float_4 out() {
       return amp_out;
     }
   };
 
+  #define GENDY_KERNELS(RENDER, DT) \
+    {{{&GendyOscillator::RENDER<false>, &GendyOscillator::walk<false, DT>}, \
+      {&GendyOscillator::RENDER<false>, &GendyOscillator::walk<true, DT>}}, \
+     {{&GendyOscillator::RENDER<true>, &GendyOscillator::walk<false, DT>}, \
+      {&GendyOscillator::RENDER<true>, &GendyOscillator::walk<true, DT>}}}
+
+  #define GENDY_LEVEL(RENDER) \
+    {GENDY_KERNELS(RENDER, LINEAR), \
+     GENDY_KERNELS(RENDER, CAUCHY), \
+     GENDY_KERNELS(RENDER, ARCSINE), \
+     GENDY_KERNELS(RENDER, LOGISTIC), \
+     GENDY_KERNELS(RENDER, HYPERBCOS), \
+     GENDY_KERNELS(RENDER, EXPONENTIAL)}
+
+  inline const GendyOscillator::Kernel &GendyOscillator::getKernel(bool fm, bool mirroring, DistType d, SimdLevel level) {
+    static_assert(NUM_DISTS == 6, "every distribution needs a row of kernels");
+    static const Kernel kernels[NUM_SIMD_LEVELS][NUM_DISTS][2][2] = {
+      GENDY_LEVEL(render),
+      GENDY_LEVEL(renderAvx2)
+    };
+
+    if ((unsigned) d >= NUM_DISTS)
+      d = LINEAR;
+    if ((unsigned) level >= NUM_SIMD_LEVELS)
+      level = SIMD_GENERIC;
+
+    return kernels[level][d][fm][mirroring];
+  }
+
+  #undef GENDY_LEVEL
+  #undef GENDY_KERNELS
+
 }
 
 #endif
@@ -0,0 +1,255 @@
+/*
+ * HalfBand.hpp
+ *
+ * Polyphase half-band FIR decimators used to bring oversampled voices
+ * back to the engine rate. Every stage halves the rate of four voice
+ * lanes at once, 2x, 4x and 8x are cascades of one, two and three
+ * stages.
+ */
+
+#ifndef __HALFBAND_HPP__
+#define __HALFBAND_HPP__
+
+#include <rack.hpp>
+
+namespace rack {
+
+  /*
+   * Taps h[M +- (2j + 1)], j = 0..K-1, of a Kaiser-windowed half-band
+   * FIR with 4K - 1 taps and centre M. The centre tap is 0.5, the other
+   * even taps are zero. Normalised to unity gain at DC.
+   */
+  template <int K> struct HalfBandCoeffs;
+
+  // 15 taps for 8x -> 4x, pass 0.05 / stop 0.45 of the input rate, -81 dB
+  template <> struct HalfBandCoeffs<4> {
+    static const float *get() {
+      static const float h[4] = {
+        2.970730936e-01f, -5.557484248e-02f, 8.715668772e-03f, -2.139198706e-04f
+      };
+      return h;
+    }
+  };
+
+  // 19 taps for 4x -> 2x, pass 0.1 / stop 0.4 of the input rate, -84 dB
+  template <> struct HalfBandCoeffs<5> {
+    static const float *get() {
+      static const float h[5] = {
+        3.029621530e-01f, -6.727361834e-02f, 1.672526566e-02f, -2.465571230e-03f,
+        5.177088663e-05f
+      };
+      return h;
+    }
+  };
+
+  // 55 taps for 2x -> 1x, pass 0.2 / stop 0.3 of the input rate, -84 dB
+  template <> struct HalfBandCoeffs<14> {
+    static const float *get() {
+      static const float h[14] = {
+        3.165685775e-01f, -1.009861597e-01f, 5.545552346e-02f, -3.462123406e-02f,
+        2.242426750e-02f, -1.450810594e-02f, 9.173208417e-03f, -5.575020944e-03f,
+        3.204668437e-03f, -1.708820400e-03f, 8.218471100e-04f, -3.395373681e-04f,
+        1.080426823e-04f, -1.725675294e-05f
+      };
+      return h;
+    }
+  };
+
+  /*
+   * Decimate by two. The odd input samples feed the symmetric taps and
+   * the even ones only the centre tap, so each output costs K multiplies
+   * for the 4K - 1 tap filter.
+   */
+  template <int K>
+  struct HalfBandDecimator {
+    // group delay in input samples, taking output t to be at the time
+    // of input 2t
+    static constexpr int DELAY = 2 * K - 2;
+
+    // inputs before the newest pair that the taps reach
+    static constexpr int HISTORY = 4 * K - 3;
+
+    // pairs appended before the window is moved back to the start
+    static constexpr int CHUNK = 16;
+
+    // the last HISTORY inputs then the pairs appended since, oldest
+    // first, so the taps always read a contiguous window
+    simd::float_4 window[HISTORY + 2 * CHUNK] = {};
+    int end = HISTORY;
+
+    void reset() {
+      prime(0.f);
+    }
+
+    /*
+     * Fill the history with a constant, as if x had been the input for
+     * as long as the filter remembers
+     */
+    void prime(simd::float_4 x) {
+      for (int i = 0; i < HISTORY; i++)
+        window[i] = x;
+      end = HISTORY;
+    }
+
+    /*
+     * Consume x0 then x1 and return one output sample
+     */
+    simd::float_4 process(simd::float_4 x0, simd::float_4 x1) {
+      const float *h = HalfBandCoeffs<K>::get();
+
+      if (end == HISTORY + 2 * CHUNK) {
+        std::copy(window + 2 * CHUNK, window + end, window);
+        end = HISTORY;
+      }
+      window[end++] = x0;
+      window[end++] = x1;
+
+      // centre tap, 2K - 1 inputs before the newest
+      const simd::float_4 *c = window + end - 2 * K;
+      simd::float_4 y = 0.5f * c[0];
+      for (int j = 0; j < K; j++)
+        y += h[j] * (c[1 + 2 * j] + c[-1 - 2 * j]);
+
+      return y;
+    }
+
+    /*
+     * Halve 2 * n samples of buf in place into its first n samples
+     */
+    void process(simd::float_4 *buf, int n) {
+      for (int i = 0; i < n; i++)
+        buf[i] = process(buf[2 * i], buf[2 * i + 1]);
+    }
+  };
+
+  /*
+   * Brings 1x, 2x, 4x or 8x oversampled lanes back to the engine rate.
+   * The stage at the highest rate has the widest transition band, so
+   * it gets the shortest filter.
+   */
+  struct DecimatorCascade {
+    HalfBandDecimator<4> stage8;  // 8x -> 4x
+    HalfBandDecimator<5> stage4;  // 4x -> 2x
+    HalfBandDecimator<14> stage2; // 2x -> 1x
+
+    void reset() {
+      stage8.reset();
+      stage4.reset();
+      stage2.reset();
+    }
+
+    /*
+     * Group delay of the stages factor uses, in output samples
+     */
+    static float delay(int factor) {
+      float d = 0.f;
+      if (factor >= 8)
+        d += HalfBandDecimator<4>::DELAY / 8.f;
+      if (factor >= 4)
+        d += HalfBandDecimator<5>::DELAY / 4.f;
+      if (factor >= 2)
+        d += HalfBandDecimator<14>::DELAY / 2.f;
+      return d;
+    }
+
+    /*
+     * Prime the stages that factor `to` uses and factor `from` did not
+     * with x, the last input sample
+     */
+    void prime(int from, int to, simd::float_4 x) {
+      if (to >= 8 && from < 8)
+        stage8.prime(x);
+      if (to >= 4 && from < 4)
+        stage4.prime(x);
+      if (to >= 2 && from < 2)
+        stage2.prime(x);
+    }
+
+    /*
+     * Decimate n * factor samples of buf in place, leaving n samples at
+     * the start of buf
+     */
+    void process(simd::float_4 *buf, int n, int factor) {
+      if (factor >= 8)
+        stage8.process(buf, n * 4);
+      if (factor >= 4)
+        stage4.process(buf, n * 2);
+      if (factor >= 2)
+        stage2.process(buf, n);
+    }
+  };
+
+  /*
+   * A DecimatorCascade whose factor can change between blocks without a
+   * click. The stages the new factor adds are primed with the last input
+   * sample, and for HANDOVER_SAMPLES output samples a copy of the old
+   * configuration keeps running on a rate-converted copy of the input
+   * while the output crossfades to the new one.
+   */
+  struct SwitchingDecimator {
+    static constexpr int HANDOVER_SAMPLES = 32;
+
+    DecimatorCascade cascade;
+    int factor = 1;
+
+    DecimatorCascade previous;
+    int previousFactor = 1;
+    int handover = 0;
+
+    void reset() {
+      cascade.reset();
+      handover = 0;
+    }
+
+    /*
+     * Switch to factor f, last is the most recent input sample
+     */
+    void setFactor(int f, simd::float_4 last) {
+      if (f == factor)
+        return;
+
+      previous = cascade;
+      previousFactor = factor;
+      handover = HANDOVER_SAMPLES;
+
+      cascade.prime(factor, f, last);
+      factor = f;
+    }
+
+    /*
+     * Decimate n * factor samples of buf in place into its first n
+     * samples. During a handover scratch must hold n * previousFactor
+     * samples.
+     */
+    void process(simd::float_4 *buf, int n, simd::float_4 *scratch) {
+      if (handover == 0) {
+        cascade.process(buf, n, factor);
+        return;
+      }
+
+      // the input as the old configuration would have seen it
+      if (previousFactor < factor) {
+        const int r = factor / previousFactor;
+        for (int i = 0; i < n * previousFactor; i++)
+          scratch[i] = buf[i * r];
+      }
+      else {
+        const int r = previousFactor / factor;
+        for (int i = 0; i < n * previousFactor; i++)
+          scratch[i] = buf[i / r];
+      }
+
+      previous.process(scratch, n, previousFactor);
+      cascade.process(buf, n, factor);
+
+      for (int t = 0; t < n && handover > 0; t++) {
+        handover--;
+        float w = (float) handover / HANDOVER_SAMPLES;
+        buf[t] += (scratch[t] - buf[t]) * w;
+      }
+    }
+  };
+
+}
+
+#endif
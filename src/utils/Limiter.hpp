@@ -8,8 +8,11 @@
 #pragma once
 
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <algorithm>
-#include <vector>
+#include <memory>
+
 
 namespace
 {
@@ -19,136 +22,396 @@ namespace
   constexpr float LIMITER_KNEE_WIDTH = 0.5f;     // Soft knee width in dB
   constexpr float ATTACK_TIME_MS = 0.1f;         // Very fast attack for transients
   constexpr float RELEASE_TIME_MS = 50.0f;       // Moderate release to avoid pumping
-  constexpr float LOOKAHEAD_TIME_MS = 5.0f;      // Lookahead buffer time
+  constexpr float LOOKAHEAD_TIME_MS = 5.0f;      // Default and longest lookahead time
+  constexpr float LOOKAHEAD_FADE_MS = 10.0f;     // Crossfade after a lookahead change
   constexpr float ENVELOPE_FOLLOWER_TAU = 1.0f;  // Envelope detector time constant
   constexpr float MIN_GAIN_REDUCTION = 0.01f;    // Minimum gain (prevents total silence)
   constexpr float AUTO_MAKEUP_RATIO = 0.8f;      // Automatic makeup gain compensation
+
+  // Buffers are sized once for the full lookahead at this rate, so that
+  // init() never allocates. Higher rates get a shorter lookahead
+  constexpr float LIMITER_MAX_SAMPLE_RATE = 768000.0f;
+  constexpr size_t LIMITER_MAX_DELAY = static_cast<size_t>(LOOKAHEAD_TIME_MS * 0.001f * LIMITER_MAX_SAMPLE_RATE) + 1;
+
+  constexpr size_t nextPowerOfTwo(size_t n, size_t p = 1)
+  {
+    return p >= n ? p : nextPowerOfTwo(n, 2 * p);
+  }
 }
 
-class AudioLimiter
+/**
+ * Gain computer of the limiter
+ * Soft knee of LIMITER_KNEE_WIDTH dB centred on LIMITER_THRESHOLD, with a
+ * hard knee at LIMITER_CEILING as safety net. The curve is the quadratic
+ * dB knee, evaluated in the linear domain: full reduction is
+ * threshold / level, and inside the narrow knee ln() and exp() are short
+ * series. Levels below the knee cost one comparison.
+ */
+class GainComputer
 {
+  // Series below are accurate to float precision for knees up to 1 dB
+  static_assert(LIMITER_KNEE_WIDTH > 0.0f && LIMITER_KNEE_WIDTH <= 1.0f, "knee too wide for the series");
+
 private:
-  // Lookahead delay line
-  std::vector<float> delayBuffer;
-  size_t delayBufferSize;
-  size_t writeIndex;
-  
-  // Envelope detection
-  float envelopeLevel;
-  float gainReduction;
-  
-  // Time constants (sample-rate dependent)
-  float attackCoeff;
-  float releaseCoeff;
-  float envelopeCoeff;
+  // Levels up to here get unity gain
+  float unityLevel;
+  float kneeStart;
+  float kneeEnd;
+  float invKneeStart;
   
-  // Sample rate
-  float sampleRate;
-  
-  // Auto gain staging
-  float makeupGain;
-  float peakHistory;
+  // Gain inside the knee is exp(-kneeCoeff * ln(level / kneeStart)^2)
+  float kneeCoeff;
   
   /**
-   * Convert time in milliseconds to coefficient for exponential filter
+   * ln(x) for x near 1, from atanh((x - 1) / (x + 1))
    */
-  float timeToCoeff(float timeMs) const
+  static float lnNearOne(float x)
   {
-    if (timeMs <= 0.0f)
-      return 0.0f;
-    return std::exp(-1.0f / (timeMs * 0.001f * sampleRate));
+    float u = (x - 1.0f) / (x + 1.0f);
+    float u2 = u * u;
+    return 2.0f * u * (1.0f + u2 * (1.0f / 3.0f + u2 * (1.0f / 5.0f)));
   }
   
   /**
-   * Convert linear amplitude to dB
+   * exp(x) for small x
    */
-  float linearToDb(float linear) const
+  static float expNearZero(float x)
+  {
+    return 1.0f + x * (1.0f + x * (1.0f / 2.0f + x * (1.0f / 6.0f + x * (1.0f / 24.0f))));
+  }
+
+public:
+  GainComputer()
   {
-    return 20.0f * std::log10(std::max(linear, 1e-6f));
+    init();
   }
   
   /**
-   * Convert dB to linear amplitude
+   * Precompute the knee, does not depend on the sample rate
    */
-  float dbToLinear(float db) const
+  void init()
   {
-    return std::pow(10.0f, db / 20.0f);
+    float halfKnee = std::pow(10.0f, LIMITER_KNEE_WIDTH / 40.0f);
+    kneeStart = LIMITER_THRESHOLD / halfKnee;
+    kneeEnd = LIMITER_THRESHOLD * halfKnee;
+    invKneeStart = 1.0f / kneeStart;
+    unityLevel = std::min(kneeStart, LIMITER_CEILING);
+    
+    // reduction of delta^2 / (2 knee) dB, delta = 20 log10(level / kneeStart)
+    kneeCoeff = 10.0f / (LIMITER_KNEE_WIDTH * std::log(10.0f));
   }
   
   /**
-   * Soft-knee compression curve
-   * Provides smooth transition into gain reduction
+   * Linear gain that brings level onto the curve
    */
-  float softKneeCompression(float inputDb, float thresholdDb, float kneeWidthDb) const
+  float process(float level) const
   {
-    if (inputDb < (thresholdDb - kneeWidthDb / 2.0f))
+    if (level <= unityLevel)
+      return 1.0f;
+    
+    float gain;
+    if (level > kneeEnd)
     {
-      // Below knee - no compression
-      return inputDb;
+      // Above knee - full compression
+      gain = LIMITER_THRESHOLD / level;
     }
-    else if (inputDb > (thresholdDb + kneeWidthDb / 2.0f))
+    else if (level >= kneeStart)
     {
-      // Above knee - full compression
-      return thresholdDb;
+      // Within knee - quadratic in dB
+      float lnRatio = lnNearOne(level * invKneeStart);
+      gain = expNearZero(-kneeCoeff * lnRatio * lnRatio);
     }
     else
     {
-      // Within knee - smooth transition using quadratic curve
-      float delta = inputDb - (thresholdDb - kneeWidthDb / 2.0f);
-      float deltaSquared = delta * delta;
-      return inputDb - (deltaSquared / (2.0f * kneeWidthDb));
+      gain = 1.0f;
     }
+    
+    // Hard knee at the ceiling, the more conservative of the two
+    if (level > LIMITER_CEILING)
+      gain = std::min(gain, LIMITER_CEILING / level);
+    
+    // Clamp to safe range
+    return std::max(gain, MIN_GAIN_REDUCTION);
+  }
+};
+
+/**
+ * Fixed-capacity delay line
+ * Returns the sample written delay samples earlier. CAPACITY is a power
+ * of two, so the ring is indexed with a mask instead of a division, and
+ * the buffer lives in the object. Delays are at most CAPACITY - 1, and
+ * any other tap up to that can be read with read().
+ */
+template <typename T, size_t CAPACITY>
+class DelayLine
+{
+  static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+  static constexpr size_t MASK = CAPACITY - 1;
+
+private:
+  T buffer[CAPACITY];
+  
+  // Free-running, wraps together with the mask
+  size_t writeIndex;
+  size_t delay;
+
+public:
+  DelayLine()
+    : writeIndex(0)
+    , delay(0)
+  {
+    reset();
   }
   
   /**
-   * Hard-knee compression curve
-   * Aggressive limiting for peak protection
+   * Set the delay in samples, the history is kept
    */
-  float hardKneeCompression(float inputDb, float thresholdDb) const
+  void setDelay(size_t delay_)
+  {
+    delay = std::min(delay_, CAPACITY - 1);
+  }
+  
+  size_t getDelay() const
   {
-    return std::min(inputDb, thresholdDb);
+    return delay;
   }
   
   /**
-   * Detect peak level in lookahead buffer
+   * Fill the line with silence
    */
-  float detectPeakLevel() const
+  void reset()
   {
-    float peak = 0.0f;
-    for (size_t i = 0; i < delayBufferSize; ++i)
-    {
-      float abs_sample = std::abs(delayBuffer[i]);
-      if (abs_sample > peak)
-        peak = abs_sample;
-    }
-    return peak;
+    std::fill(buffer, buffer + CAPACITY, T());
+    writeIndex = 0;
+  }
+  
+  /**
+   * Push one sample
+   */
+  void push(T input)
+  {
+    buffer[writeIndex++ & MASK] = input;
+  }
+  
+  /**
+   * Sample pushed tap samples before the last one
+   */
+  T read(size_t tap) const
+  {
+    return buffer[(writeIndex - 1 - tap) & MASK];
+  }
+  
+  /**
+   * Push one sample and return the one delay samples older
+   */
+  T process(T input)
+  {
+    push(input);
+    return read(delay);
+  }
+};
+
+/**
+ * Sliding-window peak detector
+ * Tracks the maximum absolute value of the last windowSize samples with a
+ * monotonic deque, so each sample costs amortized O(1) instead of a scan
+ * of the whole window. The result is identical to a full scan. Windows
+ * are at most MAX_WINDOW samples, the deque lives in the object.
+ */
+template <size_t MAX_WINDOW>
+class SlidingPeakDetector
+{
+  static_assert(MAX_WINDOW > 0, "window must hold a sample");
+
+private:
+  // Candidate peaks in decreasing order from head, stored in a ring with
+  // one spare slot, a sample is pushed before the oldest one leaves.
+  // Positions are the sample count modulo 2^32, ages are taken with
+  // unsigned wrap-around
+  static constexpr size_t CAPACITY = MAX_WINDOW + 1;
+  float levels[CAPACITY];
+  uint32_t positions[CAPACITY];
+  size_t windowSize;
+  size_t head;
+  size_t count;
+  
+  // Number of samples seen since the last reset
+  uint32_t position;
+
+public:
+  SlidingPeakDetector()
+    : windowSize(1)
+    , head(0)
+    , count(0)
+    , position(0)
+  {
+  }
+  
+  /**
+   * Set the window length in samples and clear the history
+   */
+  void init(size_t windowSize_)
+  {
+    setWindow(windowSize_);
+    reset();
+  }
+  
+  /**
+   * Change the window length and keep the history. A shorter window
+   * drops the older candidates on the next sample; a longer one only
+   * covers the samples seen after the change until it has filled
+   */
+  void setWindow(size_t windowSize_)
+  {
+    windowSize = std::max(std::min(windowSize_, MAX_WINDOW), static_cast<size_t>(1));
   }
   
   /**
-   * Calculate required gain reduction based on detected level
+   * Clear the history, as if the window was filled with silence
    */
-  float calculateGainReduction(float detectedLevel)
+  void reset()
+  {
+    head = 0;
+    count = 0;
+    position = 0;
+  }
+  
+  /**
+   * Push one sample and return the peak of the current window
+   */
+  float process(float input)
   {
-    if (detectedLevel < 1e-6f)
-      return 1.0f; // No reduction needed for silence
+    float level = std::abs(input);
     
-    float levelDb = linearToDb(detectedLevel);
-    float thresholdDb = linearToDb(LIMITER_THRESHOLD);
-    float ceilingDb = linearToDb(LIMITER_CEILING);
+    // Candidates at or below the new level can never be the peak again
+    while (count > 0)
+    {
+      size_t back = head + count - 1;
+      if (back >= CAPACITY)
+        back -= CAPACITY;
+      if (levels[back] > level)
+        break;
+      count--;
+    }
     
-    // Use soft-knee for most cases, hard-knee as safety net
-    float softKneeDb = softKneeCompression(levelDb, thresholdDb, LIMITER_KNEE_WIDTH);
-    float hardKneeDb = hardKneeCompression(levelDb, ceilingDb);
+    size_t tail = head + count;
+    if (tail >= CAPACITY)
+      tail -= CAPACITY;
+    levels[tail] = level;
+    positions[tail] = position;
+    count++;
     
-    // Choose the more conservative of the two
-    float targetDb = std::min(softKneeDb, hardKneeDb);
+    // One candidate leaves the window per sample, more after the window
+    // got shorter. The new sample always stays
+    while (static_cast<uint32_t>(position - positions[head]) >= windowSize)
+    {
+      if (++head >= CAPACITY)
+        head = 0;
+      count--;
+    }
     
-    // Calculate gain reduction
-    float reductionDb = targetDb - levelDb;
-    float reductionLinear = dbToLinear(reductionDb);
+    position++;
+    return levels[head];
+  }
+};
+
+class AudioLimiter
+{
+private:
+  // Lookahead buffers for LIMITER_MAX_DELAY samples. They are allocated
+  // once by the constructor so that a ReGrandy full of limiters stays
+  // small; init() and process() never allocate
+  struct Lookahead
+  {
+    // Delay line one sample shorter than the peak window so the sample
+    // leaving it is the oldest one the window still sees
+    DelayLine<float, nextPowerOfTwo(LIMITER_MAX_DELAY)> delayLine;
     
-    // Clamp to safe range
-    return std::max(reductionLinear, MIN_GAIN_REDUCTION);
+    // Peak of the lookahead window
+    SlidingPeakDetector<LIMITER_MAX_DELAY> peakDetector;
+  };
+  std::unique_ptr<Lookahead> lookahead;
+  
+  // Lookahead in ms, 0 is a clipper without delay
+  float lookaheadMs;
+  
+  // After a lookahead change the output fades over from the previous
+  // setting, read from the same delay line
+  size_t fadeFromDelay;
+  bool fadeFromClipper;
+  int fadeSamples;
+  int fadeRemaining;
+  
+  // Target gain for the envelope
+  GainComputer gainComputer;
+  
+  // Envelope detection
+  float envelopeLevel;
+  float gainReduction;
+  
+  // Time constants (sample-rate dependent)
+  float attackCoeff;
+  float releaseCoeff;
+  float envelopeCoeff;
+  
+  // Sample rate
+  float sampleRate;
+  
+  // Longest window at the current sample rate, that of LOOKAHEAD_TIME_MS
+  // up to LIMITER_MAX_DELAY
+  size_t maxWindow;
+  
+  // Auto gain staging
+  float makeupGain;
+  float peakHistory;
+  
+  /**
+   * Convert time in milliseconds to coefficient for exponential filter
+   */
+  float timeToCoeff(float timeMs) const
+  {
+    if (timeMs <= 0.0f)
+      return 0.0f;
+    return std::exp(-1.0f / (timeMs * 0.001f * sampleRate));
+  }
+  
+  bool isClipper() const
+  {
+    return lookaheadMs <= 0.0f;
+  }
+  
+  /**
+   * Peak window in samples of a lookahead in ms at the current rate
+   */
+  size_t windowFor(float ms) const
+  {
+    return std::max(static_cast<size_t>(ms * 0.001f * sampleRate), static_cast<size_t>(1));
+  }
+  
+  /**
+   * Size the peak window and the delay for lookaheadMs at the current
+   * sample rate, keeping their history
+   */
+  void applyLookahead()
+  {
+    size_t windowSize = std::min(windowFor(lookaheadMs), maxWindow);
+    
+    lookahead->delayLine.setDelay(windowSize - 1);
+    lookahead->peakDetector.setWindow(windowSize);
+  }
+  
+  /**
+   * Output before makeup gain of the lookahead limiter with the given
+   * delay, or of the clipper on the newest sample
+   */
+  float limit(bool clipper, size_t delay) const
+  {
+    if (clipper)
+    {
+      float x = lookahead->delayLine.read(0);
+      return x * gainComputer.process(std::abs(x));
+    }
+    return lookahead->delayLine.read(delay) * gainReduction;
   }
   
   /**
@@ -174,17 +437,23 @@ private:
 
 public:
   AudioLimiter()
-    : delayBufferSize(0)
-    , writeIndex(0)
+    : lookahead(new Lookahead)
+    , lookaheadMs(LOOKAHEAD_TIME_MS)
+    , fadeFromDelay(0)
+    , fadeFromClipper(false)
+    , fadeSamples(1)
+    , fadeRemaining(0)
     , envelopeLevel(0.0f)
     , gainReduction(1.0f)
     , attackCoeff(0.0f)
     , releaseCoeff(0.0f)
     , envelopeCoeff(0.0f)
     , sampleRate(44100.0f)
+    , maxWindow(1)
     , makeupGain(1.0f)
     , peakHistory(0.0f)
   {
+    init(sampleRate);
   }
   
   /**
@@ -194,13 +463,15 @@ public:
   {
     sampleRate = sampleRate_;
     
-    // Calculate lookahead buffer size
-    delayBufferSize = static_cast<size_t>(LOOKAHEAD_TIME_MS * 0.001f * sampleRate);
-    if (delayBufferSize < 1)
-      delayBufferSize = 1;
+    // Size the lookahead window, keeping the setting
+    maxWindow = std::min(windowFor(LOOKAHEAD_TIME_MS), LIMITER_MAX_DELAY);
+    applyLookahead();
+    lookahead->delayLine.reset();
+    lookahead->peakDetector.reset();
+    gainComputer.init();
     
-    delayBuffer.resize(delayBufferSize, 0.0f);
-    writeIndex = 0;
+    fadeSamples = std::max(static_cast<int>(LOOKAHEAD_FADE_MS * 0.001f * sampleRate), 1);
+    fadeRemaining = 0;
     
     // Calculate time constants
     attackCoeff = timeToCoeff(ATTACK_TIME_MS);
@@ -214,6 +485,39 @@ public:
     peakHistory = 0.0f;
   }
   
+  /**
+   * Set the lookahead in ms, at most LOOKAHEAD_TIME_MS. 0 turns the
+   * limiter into a clipper without latency. The output crossfades to the
+   * new setting over LOOKAHEAD_FADE_MS, nothing is allocated, so it can
+   * be called from the audio thread
+   */
+  void setLookahead(float ms)
+  {
+    ms = std::max(std::min(ms, LOOKAHEAD_TIME_MS), 0.0f);
+    if (ms == lookaheadMs)
+      return;
+    
+    fadeFromDelay = lookahead->delayLine.getDelay();
+    fadeFromClipper = isClipper();
+    fadeRemaining = fadeSamples;
+    
+    lookaheadMs = ms;
+    applyLookahead();
+  }
+  
+  float getLookahead() const
+  {
+    return lookaheadMs;
+  }
+  
+  /**
+   * Delay of the output in samples, so that a patch can compensate
+   */
+  size_t getLatency() const
+  {
+    return lookahead->delayLine.getDelay();
+  }
+  
   /**
    * Process a single audio sample through the limiter
    * Returns the limited and gain-staged output
@@ -221,10 +525,10 @@ public:
   float process(float input)
   {
     // Write input to lookahead buffer
-    delayBuffer[writeIndex] = input;
+    lookahead->delayLine.push(input);
     
     // Detect peak in lookahead window
-    float peakLevel = detectPeakLevel();
+    float peakLevel = lookahead->peakDetector.process(input);
     
     // Update envelope follower
     float targetEnvelope = peakLevel;
@@ -234,7 +538,7 @@ public:
       envelopeLevel = envelopeLevel * envelopeCoeff;
     
     // Calculate required gain reduction
-    float targetGainReduction = calculateGainReduction(envelopeLevel);
+    float targetGainReduction = gainComputer.process(envelopeLevel);
     
     // Apply attack/release to gain reduction
     if (targetGainReduction < gainReduction)
@@ -248,32 +552,47 @@ public:
       gainReduction = targetGainReduction + releaseCoeff * (gainReduction - targetGainReduction);
     }
     
-    // Read oldest sample from buffer (lookahead delay)
-    size_t readIndex = (writeIndex + 1) % delayBufferSize;
-    float delayedSample = delayBuffer[readIndex];
+    // Apply gain reduction to the delayed sample, or clip the newest one
+    float limited = limit(isClipper(), lookahead->delayLine.getDelay());
+    
+    // Blend in the previous setting after a lookahead change
+    if (fadeRemaining > 0)
+    {
+      float previous = limit(fadeFromClipper, fadeFromDelay);
+      limited += (previous - limited) * (static_cast<float>(fadeRemaining) / fadeSamples);
+      fadeRemaining--;
+    }
     
     // Update makeup gain
-    updateMakeupGain(std::abs(delayedSample * gainReduction));
+    updateMakeupGain(std::abs(limited));
     
-    // Apply gain reduction and makeup gain
-    float output = delayedSample * gainReduction * makeupGain;
+    // Apply makeup gain
+    float output = limited * makeupGain;
     
     // Safety hard clipper (should rarely engage)
     output = std::max(-LIMITER_CEILING, std::min(LIMITER_CEILING, output));
     
-    // Advance write index
-    writeIndex = (writeIndex + 1) % delayBufferSize;
-    
     return output;
   }
   
+  /**
+   * Process n samples read from in and written to out, both stepping
+   * by stride floats
+   */
+  void process(const float* in, float* out, int n, int stride)
+  {
+    for (int t = 0; t < n; ++t)
+      out[t * stride] = process(in[t * stride]);
+  }
+  
   /**
    * Reset limiter state
    */
   void reset()
   {
-    std::fill(delayBuffer.begin(), delayBuffer.end(), 0.0f);
-    writeIndex = 0;
+    lookahead->delayLine.reset();
+    lookahead->peakDetector.reset();
+    fadeRemaining = 0;
     envelopeLevel = 0.0f;
     gainReduction = 1.0f;
     peakHistory = 0.0f;
@@ -0,0 +1,68 @@
+/*
+ * SimdDispatch.hpp
+ *
+ * Hot loops whose AVX2 build differs from the generic one are compiled
+ * twice and the variant the CPU supports is picked when the plugin is
+ * loaded. A variant is a function marked SIMD_TARGET_AVX2 around a body
+ * shared with the generic one, so only what is inlined into it uses the
+ * wider instructions and the rest of the plugin stays at the baseline
+ * of the SDK build flags. The oscillator loop is the only one so far,
+ * its wavetable lookups load with the AVX2 gather.
+ */
+
+#ifndef __SIMDDISPATCH_HPP__
+#define __SIMDDISPATCH_HPP__
+
+enum SimdLevel {
+  SIMD_GENERIC,
+  SIMD_AVX2,
+  NUM_SIMD_LEVELS
+};
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+  #include <immintrin.h>
+
+  #define SIMD_DISPATCH 1
+  #define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+  // other architectures only have the generic variant
+  #define SIMD_DISPATCH 0
+  #define SIMD_TARGET_AVX2
+#endif
+
+#if defined(__GNUC__)
+  #define SIMD_INLINE inline __attribute__((always_inline))
+#else
+  #define SIMD_INLINE inline
+#endif
+
+/*
+ * Best level this CPU and OS support
+ */
+inline SimdLevel detectSimdLevel() {
+#if SIMD_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return SIMD_AVX2;
+#endif
+  return SIMD_GENERIC;
+}
+
+/*
+ * Level the kernels run at, set once at plugin init()
+ */
+inline SimdLevel &activeSimdLevel() {
+  static SimdLevel level = SIMD_GENERIC;
+  return level;
+}
+
+inline const char *simdLevelName(SimdLevel level) {
+  switch (level) {
+    case SIMD_AVX2:
+      return "AVX2";
+    default:
+      return "generic";
+  }
+}
+
+#endif
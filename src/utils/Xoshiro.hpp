@@ -0,0 +1,79 @@
+/*
+ * Xoshiro.hpp
+ *
+ * Small seedable generator for the stochastic walks. Four xoshiro128+
+ * streams run side by side, so one call gives four uniforms in a
+ * simd::float_4 without touching Rack's global generator.
+ */
+
+#ifndef __XOSHIRO_HPP__
+#define __XOSHIRO_HPP__
+
+#include <rack.hpp>
+
+namespace rack {
+
+  struct Xoshiro128x4 {
+    // state word j of stream k is sj[k]
+    uint32_t s0[4];
+    uint32_t s1[4];
+    uint32_t s2[4];
+    uint32_t s3[4];
+
+    Xoshiro128x4(uint64_t s = 0) {
+      seed(s);
+    }
+
+    /*
+     * Fill every stream from splitmix64 of the seed, so nearby seeds
+     * still give unrelated streams and the state is never all zero
+     */
+    void seed(uint64_t s) {
+      for (int k = 0; k < 4; k++) {
+        uint64_t a = splitmix64(s);
+        uint64_t b = splitmix64(s);
+        s0[k] = (uint32_t) a;
+        s1[k] = (uint32_t) (a >> 32);
+        s2[k] = (uint32_t) b;
+        s3[k] = (uint32_t) (b >> 32);
+      }
+    }
+
+    /*
+     * Next value of every stream as a uniform in [0, 1)
+     */
+    simd::float_4 uniform4() {
+      simd::float_4 r;
+
+      for (int k = 0; k < 4; k++) {
+        uint32_t result = s0[k] + s3[k];
+        uint32_t t = s1[k] << 9;
+
+        s2[k] ^= s0[k];
+        s3[k] ^= s1[k];
+        s1[k] ^= s2[k];
+        s0[k] ^= s3[k];
+        s2[k] ^= t;
+        s3[k] = (s3[k] << 11) | (s3[k] >> 21);
+
+        // the low bits of xoshiro128+ are weak, keep the top 24
+        r[k] = (float) (result >> 8) * (1.f / 16777216.f);
+      }
+
+      return r;
+    }
+
+    /*
+     * Advances x and returns the next splitmix64 output
+     */
+    static uint64_t splitmix64(uint64_t &x) {
+      uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+      return z ^ (z >> 31);
+    }
+  };
+
+}
+
+#endif
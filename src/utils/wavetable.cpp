@@ -7,6 +7,8 @@
 
 #include "wavetable.hpp"
 
+#include <mutex>
+
 namespace rack {
     float wrap(float in, float lb, float ub) {
       float out = in;
@@ -27,4 +29,96 @@ namespace rack {
       
       return out;
     }
+
+    /*
+     * The probability distribution inverse transform functions are thanks
+     * to Nick Collins Gendy UGen implementations for SuperCollider licensed
+     * under the GNU General Public License
+     */
+    namespace dist {
+      float linear(float rand) {
+        return 2.f * rand - 1.f;
+      }
+
+      float cauchy(float rand) {
+        return (1.f / A) * tanf(CAUCHY_C * (2.f * rand - 1.f)) * 0.1f;
+      }
+
+      float arcsine(float rand) {
+        return sinf(M_PI * (rand - 0.5f) * A) / ARCSINE_C;
+      }
+
+      // the remaining transforms are only defined on [0, 1]
+
+      float logistic(float rand) {
+        float temp = (clamp(rand, 0.f, 1.f) - 0.5f) * 0.998f * A + 0.5f;
+        return logf((1.f - temp) / temp) / LOGISTIC_C;
+      }
+
+      float hyperbcos(float rand) {
+        float temp = tanf(1.5692255f * A * clamp(rand, 0.f, 1.f)) / HYPERBCOS_C;
+        temp = logf(temp * 0.999f + 0.001f) * -0.1447648f;
+        return 2.f * temp - 1.f;
+      }
+
+      float exponential(float rand) {
+        float temp = logf(1.f - clamp(rand, 0.f, 1.f) * 0.999f * A) / EXPONENTIAL_C;
+        return 2.f * temp - 1.f;
+      }
+    }
+
+    const Distribution DISTRIBUTIONS[NUM_DISTS] = {
+      {"Linear", dist::linear},
+      {"Cauchy", dist::cauchy},
+      {"Arcsine", dist::arcsine},
+      {"Logistic", dist::logistic},
+      {"Hyperbolic cosine", dist::hyperbcos},
+      {"Exponential", dist::exponential},
+    };
+
+    DistTables::DistTables() {
+      for (int d = 0; d < NUM_DISTS; d++) {
+        for (int i = 0; i <= DIST_TABLE_SIZE; i++)
+          table[d][i] = DISTRIBUTIONS[d].inverse((float) i / DIST_TABLE_SIZE);
+      }
+    }
+
+    const DistTables &DistTables::get() {
+      static const DistTables tables;
+      return tables;
+    }
+
+    namespace {
+      std::mutex &registryMutex() {
+        static std::mutex mutex;
+        return mutex;
+      }
+
+      Wavetable *registryTables = nullptr;
+      int registryUsers = 0;
+    }
+
+    void WavetableRegistry::acquire() {
+      std::lock_guard<std::mutex> lock(registryMutex());
+
+      if (registryUsers++ == 0) {
+        Wavetable *tables = new Wavetable[NUM_ENVS];
+        for (int e = 0; e < NUM_ENVS; e++)
+          tables[e].switchEnvType((EnvType) e);
+        registryTables = tables;
+      }
+    }
+
+    void WavetableRegistry::release() {
+      std::lock_guard<std::mutex> lock(registryMutex());
+
+      if (--registryUsers == 0) {
+        delete[] registryTables;
+        registryTables = nullptr;
+      }
+    }
+
+    const Wavetable *WavetableRegistry::get(EnvType e) {
+      return &registryTables[e];
+    }
 }
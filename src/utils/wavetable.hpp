@@ -12,7 +12,11 @@
 
 #include <rack.hpp>
 
-#define TABLE_SIZE 2048 
+#include "SimdDispatch.hpp"
+
+#define TABLE_BITS 11
+#define TABLE_SIZE (1 << TABLE_BITS)
+#define TABLE_MASK (TABLE_SIZE - 1)
 
 namespace rack {
 
@@ -27,32 +31,92 @@ namespace rack {
   enum DistType {
     LINEAR,
     CAUCHY,
-    ARCSINE
+    ARCSINE,
+    LOGISTIC,
+    HYPERBCOS,
+    EXPONENTIAL,
+    NUM_DISTS
+  };
+
+  /*
+   * Closed-form inverse transforms. The distribution parameter is fixed
+   * at a = 0.5, so the coefficients that depend on it are constants.
+   */
+  namespace dist {
+    constexpr float A = 0.5f;
+    constexpr float CAUCHY_C = 1.3734008f;       // atan(10 a)
+    constexpr float ARCSINE_C = 0.70710677f;     // sin(pi/2 a)
+    constexpr float LOGISTIC_C = -1.0959474f;    // log((1 - c) / c), c = 0.5 + 0.499 a
+    constexpr float HYPERBCOS_C = 0.9984304f;    // tan(1.5692255 a)
+    constexpr float EXPONENTIAL_C = -0.6921477f; // log(1 - 0.999 a)
+
+    float linear(float rand);
+    float cauchy(float rand);
+    float arcsine(float rand);
+    float logistic(float rand);
+    float hyperbcos(float rand);
+    float exponential(float rand);
+  }
+
+  /*
+   * Registry of the distributions, indexed by DistType. A new one only
+   * needs its DistType, its closed form and an entry here, its lookup
+   * table is built from the closed form.
+   */
+  struct Distribution {
+    const char *name;
+    float (*inverse)(float rand);
+  };
+
+  extern const Distribution DISTRIBUTIONS[NUM_DISTS];
+
+  #define DIST_TABLE_SIZE 4096
+
+  /*
+   * Every inverse transform sampled on [0, 1], built once on first use
+   */
+  struct DistTables {
+    float table[NUM_DISTS][DIST_TABLE_SIZE + 1];
+
+    DistTables();
+
+    static const DistTables &get();
   };
 
   struct gRandGen {
-    float my_rand(DistType t, float rand) {
-      float c, temp, out;
+    const DistTables *tables = &DistTables::get();
 
-      float a = 0.5f;
-      
-      switch (t) {
-        case LINEAR:
-          return rand; 
-        case CAUCHY:
-          c = atan(10 * a);
-          temp = (1.f/a) * tan(c * (2.f * rand - 1.f));
-          out = temp*0.1f;
-          return out;
-        case ARCSINE:
-          c = sinf(1.5707963f * a); 
-		      out = sinf(M_PI * (rand - 0.5f) * a) / c;
-          return out;
-        default:
-          break;
+    /*
+     * Inverse transform of rand for distribution t. Inputs in [0, 1] are
+     * interpolated from the tables, others go through the closed form.
+     */
+    float my_rand(DistType t, float rand) const {
+      if ((unsigned) t >= NUM_DISTS)
+        return rand;
+
+      return lookup(t, rand);
+    }
+
+    /*
+     * my_rand() for a distribution fixed at compile time
+     */
+    template <DistType T>
+    float my_rand(float rand) const {
+      return lookup(T, rand);
+    }
+
+  private:
+    float lookup(DistType t, float rand) const {
+      if (rand >= 0.f && rand <= 1.f) {
+        const float *lut = tables->table[t];
+        float x = rand * (float) DIST_TABLE_SIZE;
+        int i = std::min((int) x, DIST_TABLE_SIZE - 1);
+        float ph = x - (float) i;
+
+        return lut[i] + ph * (lut[i + 1] - lut[i]);
       }
 
-      return rand;
+      return DISTRIBUTIONS[t].inverse(rand);
     }
   };
    
@@ -68,14 +132,16 @@ namespace rack {
 
   struct Wavetable {
 
-    float table[TABLE_SIZE];
+    // one cycle plus a guard copy of table[0], so interpolation at the
+    // last index never reads past the end
+    float table[TABLE_SIZE + 1];
     
     EnvType et;
 
     Wavetable() {
       // default to a cycle of a sin wave
       et = SIN;
-      initSinWav(); 
+      init(SIN); 
     }
 
     Wavetable(EnvType e) {
@@ -103,6 +169,8 @@ namespace rack {
         default:
           initSinWav();
       }
+
+      table[TABLE_SIZE] = table[0];
     }
 
     void switchEnvType(EnvType e) {
@@ -177,30 +245,114 @@ namespace rack {
       }
     }
 
-    float operator[](int x) {
+    float operator[](int x) const {
       return table[x];
     }
 
-    float operator[](float x) {
+    float operator[](float x) const {
       return index(x); 
     }
 
-    float index(float x) {
-      float fl = floorf(x);
-      float ph = x - fl;
-      float lb = table[(int) fl];
-      float ub = table[(int) ceilf(x)];
+    /*
+     * Linear interpolation at a fractional table index. The index wraps
+     * around the table, so any finite x is read in bounds.
+     */
+    float index(float x) const {
+      int i = (int) x;
+      i -= (x < (float) i); // floor for negative x
+      float ph = x - (float) i;
+      i &= TABLE_MASK;
 
-      return ((1.0 - ph) * lb) + (ph * ub);
+      return table[i] + ph * (table[i + 1] - table[i]);
     }
 
     /*
-     * Expects val 0.0 <= x < 1.0
+     * Expects val 0.0 <= x <= 1.0, values outside wrap around
      */
-    float get(float x) {
-      if (x > 1.000000) DEBUG("BAD!\n");
+    float get(float x) const {
       return index(x * (float) TABLE_SIZE); 
     }
+
+    /*
+     * get() for four phases at once
+     */
+    simd::float_4 get4(simd::float_4 x) const {
+      simd::float_4 fx = x * (float) TABLE_SIZE;
+      simd::float_4 fl = simd::floor(fx);
+      simd::float_4 ph = fx - fl;
+      simd::float_4 lb, ub;
+
+      for (int k = 0; k < 4; k++) {
+        int i = (int) fl[k] & TABLE_MASK;
+        lb[k] = table[i];
+        ub[k] = table[i + 1];
+      }
+
+      return lb + ph * (ub - lb);
+    }
+
+    /*
+     * Lookup with a 32-bit phase, the whole range of the phase is one
+     * cycle of the table. The top TABLE_BITS select the sample and the
+     * rest are the interpolation fraction.
+     */
+    float getPhase(uint32_t phase) const {
+      uint32_t i = phase >> (32 - TABLE_BITS);
+      float ph = (float) (phase & ((1u << (32 - TABLE_BITS)) - 1)) * (1.f / (float) (1u << (32 - TABLE_BITS)));
+
+      return table[i] + ph * (table[i + 1] - table[i]);
+    }
+
+    /*
+     * getPhase() for four phases at once
+     */
+    simd::float_4 getPhase4(const uint32_t *phase) const {
+      simd::float_4 r;
+      for (int k = 0; k < 4; k++)
+        r[k] = getPhase(phase[k]);
+      return r;
+    }
+
+#if SIMD_DISPATCH
+    /*
+     * getPhase4() with the indices, fractions and loads done as vectors,
+     * the loads as two AVX2 gathers. Matches getPhase4() up to the
+     * rounding of a fused multiply-add.
+     */
+    SIMD_TARGET_AVX2 simd::float_4 getPhase4Avx2(const uint32_t *phase) const {
+      const __m128i p = _mm_loadu_si128((const __m128i *) phase);
+      const __m128i i = _mm_srli_epi32(p, 32 - TABLE_BITS);
+      const __m128i f = _mm_and_si128(p, _mm_set1_epi32((1 << (32 - TABLE_BITS)) - 1));
+      const __m128 ph = _mm_mul_ps(_mm_cvtepi32_ps(f), _mm_set1_ps(1.f / (float) (1u << (32 - TABLE_BITS))));
+
+      const __m128 lb = _mm_i32gather_ps(table, i, 4);
+      const __m128 ub = _mm_i32gather_ps(table + 1, i, 4);
+
+      return simd::float_4(_mm_add_ps(lb, _mm_mul_ps(ph, _mm_sub_ps(ub, lb))));
+    }
+#endif
+  };
+
+  /*
+   * Process-wide, read-only wavetables, one per EnvType. They are built
+   * when the first Handle is created and freed when the last one goes
+   * away, so every oscillator shares the same 40 KB instead of owning
+   * its own copies. Handles are taken on the UI thread, get() is
+   * lock-free and safe on the audio thread while a Handle is held.
+   */
+  struct WavetableRegistry {
+    struct Handle {
+      Handle() { acquire(); }
+      Handle(const Handle &) { acquire(); }
+      Handle &operator=(const Handle &) { return *this; }
+      ~Handle() { release(); }
+    };
+
+    static const Wavetable *get(EnvType e);
+
+  private:
+    static void acquire();
+    static void release();
   };
 
 }